@@ -1,12 +1,46 @@
 #include <algorithm>
 #include <boost/program_options.hpp>
-#include <boost/algorithm/string/predicate.hpp>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <linux/io_uring.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
 #include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 enum returnID {
 	success_help = -1,
@@ -19,199 +53,3672 @@ enum returnID {
 	conflict_err = 5,
 	vect_nan = 6,
 	known_err = 7,
-	other_err = 8
+	other_err = 8,
+	match_err = 9,
+	infeasible_err = 10,
+	io_err = 11
+};
+
+// Digit filters run over the fixed-notation string of a number, so every
+// character maps onto a small alphabet: the digits, the decimal point and the
+// sign. The pattern automaton adds two sentinels to anchor prefixes and suffixes.
+enum digit_symbol {
+	sym_point = 10,
+	sym_minus = 11,
+	sym_begin = 12,
+	sym_end = 13
+};
+
+static constexpr int digit_alphabet = 12;
+static constexpr int pattern_alphabet = 14;
+
+inline int symbol_of(const char c) {
+	if(c >= '0' && c <= '9') return c - '0';
+	return c == '.' ? sym_point : sym_minus;
+}
+
+// Aho-Corasick automaton over every --prefix, --suffix and --contains pattern.
+// Each pattern carries the bit of its option; a number passes when every
+// option in use has matched at least once in a single pass over its digits.
+class pattern_automaton {
+public:
+	enum kind : unsigned char { prefix = 1, suffix = 2, contains = 4 };
+
+	pattern_automaton() : states(1) {}
+
+	void add(const std::string & pattern, const kind k) {
+		std::vector<int> syms;
+		if(k == prefix) syms.push_back(sym_begin);
+		for(const auto c : pattern) syms.push_back(symbol_of(c));
+		if(k == suffix) syms.push_back(sym_end);
+
+		int s = 0;
+		for(const auto sym : syms) {
+			if(states[s].next[sym] == 0) {
+				states[s].next[sym] = states.size();
+				states.emplace_back();
+			}
+			s = states[s].next[sym];
+		}
+		states[s].out |= k;
+		required |= k;
+	}
+
+	// Turns the trie into a complete transition table by following failure
+	// links breadth first, folding the output of each failure state into its
+	// referrer.
+	void compile() {
+		std::vector<int> fail(states.size(), 0), queue;
+		for(const auto child : states[0].next)
+			if(child != 0) queue.push_back(child);
+
+		for(std::size_t i = 0; i < queue.size(); ++i) {
+			const int s = queue[i];
+			states[s].out |= states[fail[s]].out;
+			for(int sym = 0; sym < pattern_alphabet; ++sym) {
+				int & child = states[s].next[sym];
+				if(child != 0) {
+					fail[child] = states[fail[s]].next[sym];
+					queue.push_back(child);
+				} else {
+					child = states[fail[s]].next[sym];
+				}
+			}
+		}
+	}
+
+	bool empty() const { return required == 0; }
+
+	bool accept(const std::string_view str) const {
+		unsigned char seen = states[0].out;
+		int s = states[0].next[sym_begin];
+		seen |= states[s].out;
+		for(const auto c : str) {
+			s = states[s].next[symbol_of(c)];
+			if((seen |= states[s].out) == required) return true;
+		}
+		seen |= states[states[s].next[sym_end]].out;
+		return seen == required;
+	}
+
+private:
+	struct state {
+		std::array<int, pattern_alphabet> next{};
+		unsigned char out = 0;
+	};
+
+	std::vector<state> states;
+	unsigned char required = 0;
+};
+
+// DFA for the --match digit regexes. The syntax is a small ERE subset:
+// literals 0-9 and '-', '\.' for the decimal point, '\d' for any digit, '.' for
+// any symbol, bracket classes, grouping, '|', and the '*', '+', '?', '{m,n}'
+// quantifiers. A number must match one of the expressions as a whole.
+class digit_dfa {
+public:
+	bool empty() const { return table.empty(); }
+
+	// Returns an empty string on success or a description of the syntax error.
+	std::string compile(const std::vector<std::string> & patterns) {
+		nfa.clear();
+		const int start = new_state();
+		const int accept = new_state();
+		for(const auto & p : patterns) {
+			src = p;
+			pos = 0;
+			fragment f;
+			try {
+				f = parse_alt();
+				if(pos != src.size()) throw std::string("unmatched ')'");
+			} catch(const std::string & what) {
+				return "'" + p + "': " + what;
+			}
+			nfa[start].eps.push_back(f.start);
+			nfa[f.accept].eps.push_back(accept);
+		}
+		return determinize(start, accept);
+	}
+
+	bool accept(const std::string_view str) const {
+		int s = 0;
+		for(const auto c : str)
+			if((s = table[s][symbol_of(c)]) < 0) return false;
+		return accepting[s];
+	}
+
+private:
+	static constexpr unsigned any_symbol = (1u << digit_alphabet) - 1;
+	static constexpr unsigned any_digit = (1u << 10) - 1;
+	static constexpr std::size_t max_states = 4096;
+	// Nested repeats multiply, so the automaton is bounded while it is built.
+	static constexpr std::size_t max_nfa_states = 1 << 16;
+
+	struct nfa_state {
+		std::vector<int> eps;
+		unsigned mask = 0;
+		int next = -1;
+	};
+
+	struct fragment { int start, accept; };
+
+	std::vector<nfa_state> nfa;
+	std::vector<std::array<int, digit_alphabet> > table;
+	std::vector<bool> accepting;
+	std::string src;
+	std::size_t pos = 0;
+
+	int new_state() {
+		if(nfa.size() == max_nfa_states) throw std::string("expressions are too complex");
+		nfa.emplace_back();
+		return nfa.size() - 1;
+	}
+
+	fragment symbol(const unsigned mask) {
+		const fragment f{new_state(), new_state()};
+		nfa[f.start].mask = mask;
+		nfa[f.start].next = f.accept;
+		return f;
+	}
+
+	fragment empty_fragment() {
+		const fragment f{new_state(), new_state()};
+		nfa[f.start].eps.push_back(f.accept);
+		return f;
+	}
+
+	bool more() const { return pos < src.size(); }
+
+	fragment parse_alt() {
+		fragment f = parse_concat();
+		while(more() && src[pos] == '|') {
+			++pos;
+			const fragment rhs = parse_concat();
+			const fragment alt{new_state(), new_state()};
+			nfa[alt.start].eps = {f.start, rhs.start};
+			nfa[f.accept].eps.push_back(alt.accept);
+			nfa[rhs.accept].eps.push_back(alt.accept);
+			f = alt;
+		}
+		return f;
+	}
+
+	fragment parse_concat() {
+		fragment f = empty_fragment();
+		while(more() && src[pos] != '|' && src[pos] != ')') {
+			const fragment next = parse_repeat();
+			nfa[f.accept].eps.push_back(next.start);
+			f.accept = next.accept;
+		}
+		return f;
+	}
+
+	std::size_t parse_count() {
+		const auto first = pos;
+		while(more() && std::isdigit(static_cast<unsigned char>(src[pos]))) ++pos;
+		if(first == pos) throw std::string("expected a repeat count");
+		std::size_t count;
+		if(std::from_chars(src.data() + first, src.data() + pos, count).ec != std::errc())
+			throw std::string("repeat count too large");
+		return count;
+	}
+
+	fragment parse_repeat() {
+		const auto atom_pos = pos;
+		fragment f = parse_atom();
+		if(!more()) return f;
+
+		std::size_t lo, hi;
+		bool unbounded = false;
+		switch(src[pos]) {
+			case '*': lo = 0; unbounded = true; ++pos; break;
+			case '+': lo = 1; unbounded = true; ++pos; break;
+			case '?': lo = 0; hi = 1; ++pos; break;
+			case '{':
+				++pos;
+				lo = hi = parse_count();
+				if(more() && src[pos] == ',') {
+					++pos;
+					if(more() && src[pos] == '}') unbounded = true;
+					else hi = parse_count();
+				}
+				if(!more() || src[pos] != '}') throw std::string("expected '}'");
+				++pos;
+				if(!unbounded && hi < lo) throw std::string("bad repeat range");
+				if(lo > 255 || (!unbounded && hi > 255)) throw std::string("repeat count too large");
+				break;
+			default: return f;
+		}
+
+		// Expand the repetition by re-parsing the atom for every copy.
+		const auto end_pos = pos;
+		auto copy = [&]() {
+			pos = atom_pos;
+			const fragment c = parse_atom();
+			pos = end_pos;
+			return c;
+		};
+
+		fragment result = empty_fragment();
+		auto append = [&](const fragment & next) {
+			nfa[result.accept].eps.push_back(next.start);
+			result.accept = next.accept;
+		};
+		for(std::size_t i = 0; i < lo; ++i) append(i == 0 ? f : copy());
+
+		if(unbounded) {
+			const fragment loop = lo == 0 ? f : copy();
+			const fragment star{new_state(), new_state()};
+			nfa[star.start].eps = {loop.start, star.accept};
+			nfa[loop.accept].eps.push_back(loop.start);
+			nfa[loop.accept].eps.push_back(star.accept);
+			append(star);
+		} else {
+			for(std::size_t i = lo; i < hi; ++i) {
+				const fragment opt = i == 0 ? f : copy();
+				nfa[opt.start].eps.push_back(opt.accept);
+				append(opt);
+			}
+		}
+		return result;
+	}
+
+	unsigned parse_escape() {
+		if(!more()) throw std::string("trailing '\\'");
+		switch(src[pos++]) {
+			case '.': return 1u << sym_point;
+			case '-': return 1u << sym_minus;
+			case 'd': return any_digit;
+			default: throw std::string("unknown escape");
+		}
+	}
+
+	unsigned parse_class() {
+		bool negate = false;
+		if(more() && src[pos] == '^') {
+			negate = true;
+			++pos;
+		}
+		unsigned mask = 0;
+		while(more() && src[pos] != ']') {
+			const char c = src[pos++];
+			if(c == '\\') {
+				mask |= parse_escape();
+			} else if(std::isdigit(static_cast<unsigned char>(c)) && pos + 1 < src.size()
+					&& src[pos] == '-' && src[pos + 1] != ']') {
+				const char last = src[pos + 1];
+				if(last < c || !std::isdigit(static_cast<unsigned char>(last)))
+					throw std::string("bad class range");
+				for(char d = c; d <= last; ++d) mask |= 1u << (d - '0');
+				pos += 2;
+			} else if(std::isdigit(static_cast<unsigned char>(c)) || c == '.' || c == '-') {
+				mask |= 1u << symbol_of(c);
+			} else {
+				throw std::string("invalid character in class");
+			}
+		}
+		if(!more()) throw std::string("expected ']'");
+		++pos;
+		return negate ? ~mask & any_symbol : mask;
+	}
+
+	fragment parse_atom() {
+		if(!more()) throw std::string("unexpected end of expression");
+		const char c = src[pos++];
+		if(std::isdigit(static_cast<unsigned char>(c)) || c == '-') return symbol(1u << symbol_of(c));
+		switch(c) {
+			case '.': return symbol(any_symbol);
+			case '\\': return symbol(parse_escape());
+			case '[': return symbol(parse_class());
+			case '(': {
+				const fragment f = parse_alt();
+				if(!more() || src[pos] != ')') throw std::string("expected ')'");
+				++pos;
+				return f;
+			}
+			default: throw std::string("unexpected '") + c + '\'';
+		}
+	}
+
+	void closure(std::vector<int> & set) const {
+		std::vector<bool> in(nfa.size(), false);
+		std::vector<int> seeds;
+		seeds.swap(set);
+		for(const auto s : seeds) {
+			if(!in[s]) {
+				in[s] = true;
+				set.push_back(s);
+			}
+		}
+		for(std::size_t i = 0; i < set.size(); ++i) {
+			for(const auto e : nfa[set[i]].eps) {
+				if(!in[e]) {
+					in[e] = true;
+					set.push_back(e);
+				}
+			}
+		}
+		std::sort(set.begin(), set.end());
+	}
+
+	std::string determinize(const int start, const int accept) {
+		std::map<std::vector<int>, int> ids;
+		std::vector<std::vector<int> > sets{{start}};
+		closure(sets[0]);
+		ids[sets[0]] = 0;
+		table.clear();
+		accepting.clear();
+
+		for(std::size_t i = 0; i < sets.size(); ++i) {
+			table.emplace_back();
+			accepting.push_back(std::binary_search(sets[i].begin(), sets[i].end(), accept));
+			for(int sym = 0; sym < digit_alphabet; ++sym) {
+				std::vector<int> next;
+				for(const auto s : sets[i])
+					if(nfa[s].mask & (1u << sym)) next.push_back(nfa[s].next);
+				if(next.empty()) {
+					table[i][sym] = -1;
+					continue;
+				}
+				closure(next);
+				auto found = ids.find(next);
+				if(found == ids.end()) {
+					if(sets.size() == max_states) return "expressions are too complex";
+					found = ids.emplace(next, sets.size()).first;
+					sets.push_back(next);
+				}
+				table[i][sym] = found->second;
+			}
+		}
+		nfa.clear();
+		return "";
+	}
+};
+
+// Samples directly from the numbers whose printed form satisfies --prefix and
+// --suffix. At a fixed precision p every printed value is an integer k scaled
+// by 10^-p; a prefix selects a union of k intervals (one per digit count) and a
+// suffix an arithmetic lattice of k. Each k owns the cell of reals that rounds
+// to it, so drawing a lattice point and then a point inside its cell keeps the
+// distribution of plain rejection sampling while accepting every draw.
+class digit_sampler {
+public:
+	bool active() const { return !pieces.empty(); }
+	bool impossible() const { return enumerated && pieces.empty(); }
+
+	// Builds the pieces, returning false when the constraint cannot be
+	// enumerated (k beyond 10^18, an over-long suffix, or a suffix with
+	// negative numbers in range, which print as -k). cell_offset is where
+	// the cell of k starts in units of 10^-p: -0.5 for rounding to nearest, 0
+	// for floor and trunc, -1 for ceil. With decimal set the draws are the
+	// lattice points k themselves, as generated by --decimal.
+	bool build(const std::vector<std::string> & prefixes, const std::vector<std::string> & suffixes,
+			const int precision, const long double lbound, const long double ubound,
+			const long double cell_offset, const bool decimal) {
+		pieces.clear();
+		cumulative.clear();
+		enumerated = false;
+		points = decimal;
+		if(prefixes.empty() && suffixes.empty()) return false;
+		// Prefixes are digits and never match a sign, but a suffix matches
+		// -k as well as k; leave those to rejection.
+		if(!suffixes.empty() && lbound < 0) return false;
+
+		scale = std::pow(10.0L, precision);
+		const long double lo = std::max(lbound, 0.0L) * scale, hi = ubound * scale;
+		if(hi < lo) return enumerated = true;
+		if(hi - cell_offset >= max_k) return false;
+
+		const bool ceil = cell_offset <= -1;
+		const auto kmin = points ? static_cast<unsigned long long>(std::ceil(lo))
+			: std::max<unsigned long long>(std::floor(lo - cell_offset), ceil);
+		const auto kmax = static_cast<unsigned long long>(std::floor(points ? hi : hi - cell_offset));
+		if(kmax < kmin) return enumerated = true;
+
+		std::vector<std::pair<unsigned long long, unsigned long long> > ranges;
+		if(prefixes.empty()) ranges.emplace_back(kmin, kmax);
+		for(const auto & p : prefixes) prefix_ranges(p, precision, kmin, kmax, ranges);
+		ranges = merge(ranges);
+
+		std::vector<lattice> lattices;
+		if(suffixes.empty()) lattices.push_back({1, 0, 0});
+		for(const auto & s : suffixes)
+			if(!suffix_lattice(s, precision, lattices)) return false;
+		lattices = dedupe(lattices);
+
+		for(const auto & r : ranges)
+			for(const auto & l : lattices)
+				add(r.first, r.second, l, lo, hi, cell_offset);
+
+		long double total = 0;
+		for(const auto & p : pieces) cumulative.push_back(total += p.count * p.width);
+		return enumerated = true;
+	}
+
+	template<typename GEN>
+	long double operator()(GEN & generator) const {
+		const long double w = std::uniform_real_distribution<long double>{0, cumulative.back()}(generator);
+		const auto i = std::min<std::size_t>(pieces.size() - 1,
+			std::upper_bound(cumulative.begin(), cumulative.end(), w) - cumulative.begin());
+		const auto & p = pieces[i];
+		const auto j = p.count == 1 ? 0 :
+			std::uniform_int_distribution<unsigned long long>{0, p.count - 1}(generator);
+		if(points) return p.first + j * p.step;
+		const long double u = std::uniform_real_distribution<long double>{0, p.width}(generator);
+		return (static_cast<long double>(p.first + j * p.step) + p.offset + u) / scale;
+	}
+
+private:
+	static constexpr long double max_k = 1e18L;
+	static constexpr int max_digits = 18;
+
+	// The cells of k = first + j * step for j < count, each starting at
+	// offset and width units wide after clipping to the bounds.
+	struct piece {
+		unsigned long long first, step, count;
+		long double offset, width;
+	};
+
+	// k = residue (mod modulus), and k >= floor.
+	struct lattice { unsigned long long modulus, residue, floor; };
+
+	std::vector<piece> pieces;
+	std::vector<long double> cumulative;
+	long double scale = 1;
+	bool enumerated = false, points = false;
+
+	static unsigned long long pow10(const int n) {
+		unsigned long long r = 1;
+		for(int i = 0; i < n; ++i) r *= 10;
+		return r;
+	}
+
+	static void prefix_ranges(const std::string & prefix, const int precision,
+			const unsigned long long kmin, const unsigned long long kmax,
+			std::vector<std::pair<unsigned long long, unsigned long long> > & ranges) {
+		std::string digits;
+		for(const auto c : prefix) if(c != '.') digits += c;
+
+		// One interval per digit count of k; shorter k are zero padded to
+		// precision + 1 digits, so the point always follows the units digit.
+		for(int len = precision + 1; len <= max_digits; ++len) {
+			const auto point = len - precision;
+			if(digits.size() > static_cast<std::size_t>(len)) continue;
+			bool fits = true;
+			for(std::size_t i = 0; i < prefix.size(); ++i)
+				fits = fits && ((prefix[i] == '.') == (precision > 0 && i == static_cast<std::size_t>(point)));
+			if(!fits) continue;
+
+			const auto width = pow10(len - digits.size());
+			const auto value = digits.empty() ? 0 : std::stoull(digits);
+			const auto first = std::max({value * width, len == precision + 1 ? 0 : pow10(len - 1), kmin});
+			const auto last = std::min({(value + 1) * width - 1, pow10(len) - 1, kmax});
+			if(first <= last) ranges.emplace_back(first, last);
+		}
+	}
+
+	static std::vector<std::pair<unsigned long long, unsigned long long> >
+	merge(std::vector<std::pair<unsigned long long, unsigned long long> > ranges) {
+		std::sort(ranges.begin(), ranges.end());
+		std::vector<std::pair<unsigned long long, unsigned long long> > merged;
+		for(const auto & r : ranges) {
+			if(!merged.empty() && r.first <= merged.back().second + 1)
+				merged.back().second = std::max(merged.back().second, r.second);
+			else
+				merged.push_back(r);
+		}
+		return merged;
+	}
+
+	static bool suffix_lattice(const std::string & suffix, const int precision, std::vector<lattice> & lattices) {
+		const auto point = suffix.find('.');
+		std::string digits;
+		for(const auto c : suffix) if(c != '.') digits += c;
+
+		// The point sits exactly precision digits from the end, and not at all
+		// when the precision is zero.
+		if(point == std::string::npos
+				? precision > 0 && digits.size() > static_cast<std::size_t>(precision)
+				: suffix.size() - point - 1 != static_cast<std::size_t>(precision) || precision == 0)
+			return true;
+		if(digits.size() > max_digits) return false;
+
+		const auto modulus = pow10(digits.size());
+		const bool padded = digits.size() <= static_cast<std::size_t>(precision + 1) || digits[0] != '0';
+		lattices.push_back({modulus, digits.empty() ? 0 : std::stoull(digits), padded ? 0 : modulus});
+		return true;
+	}
+
+	// Drops lattices contained in a coarser one so no k is counted twice;
+	// suffixes that are not suffixes of each other select disjoint k.
+	static std::vector<lattice> dedupe(std::vector<lattice> lattices) {
+		std::sort(lattices.begin(), lattices.end(),
+			[](const lattice & a, const lattice & b) { return a.modulus < b.modulus; });
+		std::vector<lattice> kept;
+		for(const auto & l : lattices) {
+			if(std::none_of(kept.begin(), kept.end(), [&](const lattice & k) {
+					return l.residue % k.modulus == k.residue; }))
+				kept.push_back(l);
+		}
+		return kept;
+	}
+
+	void add(const unsigned long long a, const unsigned long long b, const lattice & l,
+			const long double lo, const long double hi, const long double cell_offset) {
+		const auto start = std::max(a, l.floor);
+		if(start > b) return;
+		const auto first = start + (l.residue % l.modulus + l.modulus - start % l.modulus) % l.modulus;
+		if(first > b) return;
+		const auto count = (b - first) / l.modulus + 1;
+		const auto last = first + (count - 1) * l.modulus;
+		if(points) {
+			pieces.push_back({first, l.modulus, count, 0, 1});
+			return;
+		}
+
+		// Only the outermost cells can be cut by the bounds.
+		auto clipped = [&](const unsigned long long k) {
+			const long double cell = k + cell_offset;
+			const long double from = std::max(cell, lo), to = std::min(cell + 1, hi);
+			if(to > from) pieces.push_back({k, l.modulus, 1, from - static_cast<long double>(k), to - from});
+		};
+		clipped(first);
+		if(count > 2) pieces.push_back({first + l.modulus, l.modulus, count - 2, cell_offset, 1});
+		if(count > 1) clipped(last);
+	}
+};
+
+// Per-stage counters for --profile. Stages are timed in TSC ticks, which are
+// converted to nanoseconds against the steady clock once the run is over; with
+// the flag off every probe is a single predictable branch.
+class profiler {
+public:
+	enum stage {
+		generate, parse, round, exclude, include, digits, dedup, format, write,
+		stat_stream, stat_sketch, stat_median, stat_quantile, stat_hist, stat_window,
+		stage_count
+	};
+
+	// Times the enclosing block.
+	class scope {
+	public:
+		scope(profiler & p, const stage s) : prof(p.enabled ? &p : nullptr), which(s),
+			start(prof ? ticks() : 0) {}
+		~scope() { if(prof) prof->add(which, ticks() - start); }
+	private:
+		profiler * prof;
+		stage which;
+		unsigned long long start;
+	};
+
+	bool enabled = false;
+	unsigned long long draws = 0, accepted = 0, bytes = 0;
+	// --output's io_uring queue: buffers, most in flight, waits for one
+	unsigned long long io_depth = 0, io_peak = 0, io_stalls = 0, io_stall_ns = 0;
+
+	void start() {
+		if(!enabled) return;
+		wall_start = std::chrono::steady_clock::now();
+		tick_start = ticks();
+	}
+
+	void add(const stage s, const unsigned long long elapsed) {
+		++calls[s];
+		cycles[s] += elapsed;
+	}
+
+	void report(std::ostream & os) const {
+		if(!enabled) return;
+		const auto wall = std::chrono::duration<long double, std::nano>(
+			std::chrono::steady_clock::now() - wall_start).count();
+		const long double per_ns = wall > 0 ? (ticks() - tick_start) / wall : 1;
+
+		os << std::defaultfloat << std::setprecision(6)
+			<< "{\"wall_ns\": " << wall
+			<< ", \"ticks_per_ns\": " << per_ns
+			<< ", \"draws\": " << draws
+			<< ", \"accepted\": " << accepted
+			<< ", \"bytes\": " << bytes
+			<< ", \"bytes_per_s\": " << (wall > 0 ? bytes / wall * 1e9L : 0)
+			<< ", \"io\": {\"depth\": " << io_depth << ", \"peak\": " << io_peak
+			<< ", \"stalls\": " << io_stalls << ", \"stall_ns\": " << io_stall_ns << '}'
+			<< ", \"stages\": {";
+		const char * sep = "";
+		for(int s = 0; s < stage_count; ++s) {
+			if(calls[s] == 0) continue;
+			os << sep << "\"" << names[s] << "\": {\"calls\": " << calls[s]
+				<< ", \"ticks\": " << cycles[s]
+				<< ", \"ns\": " << cycles[s] / per_ns << '}';
+			sep = ", ";
+		}
+		os << "}}\n";
+	}
+
+	static unsigned long long ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+private:
+	static constexpr const char * names[stage_count] = {
+		"generate", "parse", "round", "exclude", "include", "digits", "dedup", "format", "write",
+		"stat_stream", "stat_sketch", "stat_median", "stat_quantile", "stat_hist", "stat_window"
+	};
+
+	std::array<unsigned long long, stage_count> calls{}, cycles{};
+	std::chrono::steady_clock::time_point wall_start;
+	unsigned long long tick_start = 0;
+};
+
+profiler profile;
+
+// Trace-event recorder for --trace, readable by chrome://tracing and Perfetto.
+// Every thread appends complete spans to its own single-producer ring and a
+// flusher thread drains the rings into the file, so recording never takes a
+// lock; a span that finds its ring full is dropped and counted instead.
+class tracer {
+public:
+	// Records the enclosing block as a span.
+	class span {
+	public:
+		span(tracer & t, const char * n, const long long c = 0) : trace(t.enabled() ? &t : nullptr),
+			name(n), count(c), start(trace ? trace->now() : 0) {}
+		~span() { if(trace) trace->record(name, start, trace->now() - start, count); }
+	private:
+		tracer * trace;
+		const char * name;
+		long long count, start;
+	};
+
+	~tracer() { close(); }
+
+	bool enabled() const { return out.is_open(); }
+
+	bool open(const std::string & path) {
+		out.open(path);
+		if(!out) return false;
+		epoch = std::chrono::steady_clock::now();
+		out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n"
+			<< "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"diceroll\"}}";
+		stop = false;
+		flusher = std::thread([this]() {
+			while(!stop.load(std::memory_order_acquire)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				drain();
+			}
+		});
+		return true;
+	}
+
+	void close() {
+		if(!enabled()) return;
+		stop.store(true, std::memory_order_release);
+		flusher.join();
+		drain();
+		unsigned long long dropped = 0;
+		for(const auto & r : rings) dropped += r->dropped.load(std::memory_order_relaxed);
+		out << "\n], \"otherData\": {\"dropped\": " << dropped << "}}\n";
+		out.close();
+	}
+
+	void record(const char * name, const long long start, const long long duration, const long long count) {
+		ring & r = local();
+		const auto head = r.head.load(std::memory_order_relaxed);
+		if(head - r.tail.load(std::memory_order_acquire) == ring_size) {
+			r.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		r.events[head % ring_size] = {name, start, duration, count};
+		r.head.store(head + 1, std::memory_order_release);
+	}
+
+private:
+	static constexpr std::size_t ring_size = 1 << 14;
+
+	struct event {
+		const char * name;
+		long long start, duration, count;
+	};
+
+	struct ring {
+		std::array<event, ring_size> events;
+		std::atomic<std::size_t> head{0}, tail{0};
+		std::atomic<unsigned long long> dropped{0};
+		int tid;
+	};
+
+	std::ofstream out;
+	std::chrono::steady_clock::time_point epoch;
+	std::vector<std::unique_ptr<ring> > rings;
+	std::mutex registry;
+	std::thread flusher;
+	std::atomic<bool> stop{false};
+
+	long long now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	// Registration is the only locked step and happens once per thread.
+	ring & local() {
+		thread_local ring * mine = nullptr;
+		if(!mine) {
+			const std::lock_guard<std::mutex> lock{registry};
+			rings.emplace_back(new ring);
+			mine = rings.back().get();
+			mine->tid = rings.size();
+		}
+		return *mine;
+	}
+
+	void drain() {
+		const std::lock_guard<std::mutex> lock{registry};
+		for(const auto & r : rings) {
+			const auto head = r->head.load(std::memory_order_acquire);
+			auto tail = r->tail.load(std::memory_order_relaxed);
+			for(; tail != head; ++tail) {
+				const auto & e = r->events[tail % ring_size];
+				out << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << r->tid
+					<< ", \"ts\": " << e.start / 1000 << '.' << std::setfill('0') << std::setw(3) << e.start % 1000
+					<< ", \"dur\": " << e.duration / 1000 << '.' << std::setw(3) << e.duration % 1000
+					<< std::setfill(' ') << ", \"args\": {\"count\": " << e.count << "}}";
+			}
+			r->tail.store(tail, std::memory_order_release);
+		}
+	}
+};
+
+tracer trace;
+
+// SIGINT and SIGTERM end a run after the batch in hand, so that the output
+// stays whole and the stats still print; a second one kills as usual.
+volatile std::sig_atomic_t interrupted = 0;
+
+void interrupt(int) { interrupted = 1; }
+
+// Fixed-notation formatting without iostreams or printf. The value is split
+// into an integer part and an exact binary fraction m / 2^s; the fraction is
+// scaled by 10^precision in 192-bit arithmetic and rounded half to even, which
+// is what printf("%.*f") and std::fixed do with the exact binary value.
+namespace fixed_format {
+	using u64 = unsigned long long;
+	using u128 = unsigned __int128;
+
+	static constexpr int max_precision = 21;
+
+	// Bit k of the 192-bit number w.
+	inline bool bit(const u64 (& w)[3], const int k) {
+		return k < 192 && (w[k / 64] >> (k % 64) & 1);
+	}
+
+	// Whether any of the k lowest bits of w are set.
+	inline bool any_below(const u64 (& w)[3], const int k) {
+		for(int i = 0; i < 3; ++i) {
+			const int bits = std::min(64, k - 64 * i);
+			if(bits <= 0) break;
+			if(w[i] & (bits == 64 ? ~0ull : (1ull << bits) - 1)) return true;
+		}
+		return false;
+	}
+
+	// Low 128 bits of w >> s.
+	inline u128 shifted(const u64 (& w)[3], const int s) {
+		if(s >= 192) return 0;
+		u64 out[3] = {};
+		const int limbs = s / 64, bits = s % 64;
+		for(int i = 0; i + limbs < 3; ++i) {
+			out[i] = w[i + limbs] >> bits;
+			if(bits && i + limbs + 1 < 3) out[i] |= w[i + limbs + 1] << (64 - bits);
+		}
+		return static_cast<u128>(out[1]) << 64 | out[0];
+	}
+
+	inline u128 pow10(const int n) {
+		u128 r = 1;
+		for(int i = 0; i < n; ++i) r *= 10;
+		return r;
+	}
+
+	static constexpr char digit_pairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+	// Decimal length of v from its bit length, with a single correction.
+	inline int count_digits(const u64 v) {
+		static constexpr u64 powers[] = {0, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+			100000000, 1000000000, 10000000000ull, 100000000000ull, 1000000000000ull,
+			10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+			100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull};
+		const int t = (64 - __builtin_clzll(v | 1)) * 1233 >> 12;
+		return t - (v < powers[t]) + 1;
+	}
+
+	// Writes the n lowest decimal digits of v, zero padded, ending at last.
+	inline char * digits(char * last, u64 v, int n) {
+		for(; n >= 2; n -= 2) {
+			last -= 2;
+			std::memcpy(last, digit_pairs + 2 * (v % 100), 2);
+			v /= 100;
+		}
+		if(n) *--last = '0' + v % 10;
+		return last;
+	}
+
+	inline char * integer(char * first, const u64 v) {
+		const int n = count_digits(v);
+		digits(first + n, v, n);
+		return first + n;
+	}
+
+	inline char * integer(char * first, const long long v) {
+		if(v < 0) *first++ = '-';
+		return integer(first, v < 0 ? 0 - static_cast<u64>(v) : static_cast<u64>(v));
+	}
+
+	// Splits off 19 digits at a time so only one 128-bit division is needed.
+	inline char * digits(char * last, const u128 v, const int n) {
+		static constexpr u64 e19 = 10000000000000000000ull;
+		if(n <= 19) return digits(last, static_cast<u64>(v), n);
+		last = digits(last, static_cast<u64>(v % e19), 19);
+		return digits(last, static_cast<u64>(v / e19), n - 19);
+	}
+
+	// Returns the end of the text, or nullptr when v is outside what this path
+	// handles (non-finite, |v| >= 2^64, wide mantissas, large precisions) and
+	// the caller has to fall back to printf. Needs 64 bytes of room.
+	template<typename T>
+	char * format(char * first, const T v, const int precision) {
+		static constexpr int mantissa = std::numeric_limits<T>::digits;
+		if(mantissa > 64 || precision > max_precision || !std::isfinite(v)) return nullptr;
+
+		if(std::signbit(v)) *first++ = '-';
+		int e;
+		const T frac = std::frexp(std::fabs(v), &e);
+		const auto m = static_cast<u64>(std::ldexp(frac, mantissa));
+		e -= mantissa;
+		if(e + mantissa > 64) return nullptr;
+
+		// v = whole + low / 2^s
+		u64 whole = 0, low = 0;
+		int s = 0;
+		if(e >= 0) {
+			whole = m << e;
+		} else {
+			s = -e;
+			whole = s >= 64 ? 0 : m >> s;
+			low = s >= 64 ? m : m & ((1ull << s) - 1);
+		}
+
+		u128 fraction = 0;
+		if(low != 0) {
+			const u128 scale = pow10(precision);
+			const u128 a = static_cast<u128>(low) * static_cast<u64>(scale);
+			const u128 b = static_cast<u128>(low) * static_cast<u64>(scale >> 64);
+			const u128 mid = (a >> 64) + static_cast<u64>(b);
+			const u64 product[3] = {static_cast<u64>(a), static_cast<u64>(mid),
+				static_cast<u64>(mid >> 64) + static_cast<u64>(b >> 64)};
+
+			// Ties go to the even last digit, which is the units digit at
+			// precision 0.
+			fraction = shifted(product, s);
+			const bool odd = (precision == 0 ? whole : static_cast<u64>(fraction)) & 1;
+			if(bit(product, s - 1) && (any_below(product, s - 1) || odd)) ++fraction;
+			if(fraction == scale) {
+				fraction = 0;
+				++whole;
+			}
+		}
+
+		first = integer(first, whole);
+		if(precision > 0) {
+			*first++ = '.';
+			first += precision;
+			digits(first, fraction, precision);
+		}
+		return first;
+	}
+
+	// Writes k / 10^precision, the text std::fixed gives for that decimal.
+	inline char * scaled(char * first, const long long k, const int precision) {
+		if(precision == 0) return integer(first, k);
+		u64 v = k;
+		if(k < 0) {
+			*first++ = '-';
+			v = 0 - v;
+		}
+		const int n = std::max(count_digits(v), precision + 1);
+		char * const point = first + n - precision;
+		digits(first + n + 1, v, precision);
+		digits(point, v / static_cast<u64>(pow10(precision)), n - precision);
+		*point = '.';
+		return first + n + 1;
+	}
+}
+
+// Text of every value in a small integer range with the delimiter already
+// appended, so printing a die face is a single memcpy. Values are in the units
+// numbers are generated in: integers under rounding, k under --decimal.
+class number_table {
+public:
+	static constexpr long long max_size = 1 << 16;
+
+	bool build(const long long lo, const long long hi, const int precision, const std::string & delim) {
+		if(hi < lo || hi - lo >= max_size) return false;
+		first = lo;
+		offsets.assign(1, 0);
+		text.clear();
+		char buf[48];
+		for(long long v = lo; v <= hi; ++v) {
+			text.append(buf, fixed_format::scaled(buf, v, precision) - buf);
+			text += delim;
+			offsets.push_back(text.size());
+		}
+		return true;
+	}
+
+	// Empty when v is outside the table, or the negative zero rounding can
+	// produce, which prints as "-0".
+	std::string_view operator[](const long double v) const {
+		const auto i = static_cast<long long>(v) - first;
+		if(i < 0 || i + 1 >= static_cast<long long>(offsets.size()) || (v == 0 && std::signbit(v))) return {};
+		return std::string_view(text.data() + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+private:
+	long long first = 0;
+	std::vector<std::size_t> offsets;
+	std::string text;
+};
+
+// Just enough of io_uring for output_writer to keep file writes in flight,
+// on the raw system calls rather than liburing.
+class io_ring {
+public:
+	io_ring() = default;
+	io_ring(const io_ring &) = delete;
+	io_ring & operator=(const io_ring &) = delete;
+
+	~io_ring() {
+		if(sqes) munmap(sqes, sqe_bytes);
+		if(cq_map && cq_map != sq_map) munmap(cq_map, cq_bytes);
+		if(sq_map) munmap(sq_map, sq_bytes);
+		if(fd >= 0) ::close(fd);
+	}
+
+	// False when the kernel has no io_uring or will not give us one.
+	bool open(const unsigned entries) {
+		io_uring_params p{};
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+		if(fd < 0) return false;
+		const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+		sq_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		if(single) sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+		sq_map = map(sq_bytes, IORING_OFF_SQ_RING);
+		cq_map = single ? sq_map : map(cq_bytes, IORING_OFF_CQ_RING);
+		sqe_bytes = p.sq_entries * sizeof(io_uring_sqe);
+		sqes = static_cast<io_uring_sqe *>(map(sqe_bytes, IORING_OFF_SQES));
+		if(!sq_map || !cq_map || !sqes) return false;
+
+		const auto field = [](void * base, const unsigned offset) {
+			return reinterpret_cast<unsigned *>(static_cast<char *>(base) + offset);
+		};
+		sq_tail = field(sq_map, p.sq_off.tail);
+		sq_mask = *field(sq_map, p.sq_off.ring_mask);
+		sq_array = field(sq_map, p.sq_off.array);
+		cq_head = field(cq_map, p.cq_off.head);
+		cq_tail = field(cq_map, p.cq_off.tail);
+		cq_mask = *field(cq_map, p.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(cq_map) + p.cq_off.cqes);
+		return true;
+	}
+
+	bool register_buffers(const std::vector<iovec> & buffers) {
+		return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+			buffers.data(), buffers.size()) == 0;
+	}
+
+	void unregister_buffers() {
+		syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+	}
+
+	// Queues a write of data to file at offset; index names a registered
+	// buffer, or -1. The tag comes back with the completion.
+	void write(const int file, const char * data, const unsigned len,
+			const unsigned long long offset, const int index, const unsigned long long tag) {
+		const unsigned tail = *sq_tail;
+		const unsigned i = tail & sq_mask;
+		io_uring_sqe & sqe = sqes[i];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = index < 0 ? IORING_OP_WRITE : IORING_OP_WRITE_FIXED;
+		sqe.fd = file;
+		sqe.addr = reinterpret_cast<unsigned long long>(data);
+		sqe.len = len;
+		sqe.off = offset;
+		sqe.buf_index = index < 0 ? 0 : index;
+		sqe.user_data = tag;
+		sq_array[i] = i;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		enter(1, 0, 0);
+	}
+
+	// Blocks until a write completes.
+	io_uring_cqe wait() {
+		for(;;) {
+			const unsigned head = *cq_head;
+			if(head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+				const io_uring_cqe cqe = cqes[head & cq_mask];
+				__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+				return cqe;
+			}
+			enter(0, 1, IORING_ENTER_GETEVENTS);
+		}
+	}
+
+private:
+	int fd = -1;
+	void * sq_map = nullptr;
+	void * cq_map = nullptr;
+	io_uring_sqe * sqes = nullptr;
+	std::size_t sq_bytes = 0, cq_bytes = 0, sqe_bytes = 0;
+	unsigned * sq_tail = nullptr;
+	unsigned * sq_array = nullptr;
+	unsigned * cq_head = nullptr;
+	unsigned * cq_tail = nullptr;
+	unsigned sq_mask = 0, cq_mask = 0;
+	io_uring_cqe * cqes = nullptr;
+
+	void * map(const std::size_t size, const long long offset) {
+		void * p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+		return p == MAP_FAILED ? nullptr : p;
+	}
+
+	void enter(unsigned submit, const unsigned complete, const unsigned flags) {
+		while(syscall(__NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0) < 0) {
+			if(errno != EINTR) throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+			submit = 0;
+		}
+	}
+};
+
+// Stores v at first in little-endian byte order; size trims the padding of
+// the 80-bit long double.
+template<typename T>
+void little_endian(char * first, const T v, const std::size_t size = sizeof(T)) {
+	std::memcpy(first, &v, size);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	std::reverse(first, first + size);
+#endif
+}
+
+// Buffered writer for the number output. Text is formatted straight into a
+// large page-aligned buffer which goes to the descriptor with write(2), so the
+// hot loop never touches iostreams. splice() and queue() trade the write for
+// vmsplice on pipes and io_uring on files; both need more than one buffer,
+// so the storage holds slots of the buffer's size and buffer is the one
+// being filled.
+class output_writer {
+public:
+	explicit output_writer(const int descriptor = STDOUT_FILENO, const std::size_t size = 1 << 20)
+		: fd(descriptor), capacity(size), storage(nullptr, &std::free), used(0) {
+		allocate(1);
+	}
+
+	~output_writer() {
+		try { finish(); } catch(...) {}
+	}
+
+	std::size_t pending() const { return used; }
+	std::size_t size() const { return capacity; }
+
+	// True once enough is buffered to be worth a write: half the buffer, or
+	// all of it when buffers go out whole.
+	bool due() const { return used >= (whole() ? capacity : capacity / 2); }
+
+	// Switches to vmsplice when the descriptor is a pipe. The buffer shrinks
+	// or grows to the pipe's size and a second one is added: a buffer is only
+	// spliced whole, so once the other has gone in after it the pipe no
+	// longer holds its pages and it can be refilled. Anything short of a
+	// whole buffer is written as usual. Returns false, leaving write in
+	// place, for files, ttys and pipes that refuse to resize.
+	bool splice() {
+		struct stat st;
+		if(used || ring || fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode)) return false;
+		int size = fcntl(fd, F_SETPIPE_SZ, static_cast<int>(capacity));
+		if(size < 0) size = fcntl(fd, F_GETPIPE_SZ);
+		if(size <= 0 || size % page_size) return false;
+		capacity = size;
+		allocate(2);
+		spliced = true;
+		return true;
+	}
+
+	// Moves writes to a regular file onto io_uring with depth buffers, which
+	// are registered with the kernel when it allows, so formatting carries on
+	// while earlier buffers are written. Under O_DIRECT every write but the
+	// last is a whole buffer; the last one's unaligned tail is written once
+	// O_DIRECT is dropped. Returns false, leaving write in place, for other
+	// descriptors or without io_uring, and drops O_DIRECT then since plain
+	// writes cannot split off the tail.
+	bool queue(const unsigned depth) {
+		struct stat st;
+		const int status = fcntl(fd, F_GETFL);
+		if(!used && !spliced && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+			auto r = std::make_unique<io_ring>();
+			if(r->open(depth)) {
+				allocate(depth);
+				ring = std::move(r);
+				register_storage();
+				direct = status >= 0 && (status & O_DIRECT);
+				lengths.assign(depth, 0);
+				offsets.assign(depth, 0);
+				release();
+				profile.io_depth = depth;
+				return true;
+			}
+		}
+		if(status >= 0 && (status & O_DIRECT)) fcntl(fd, F_SETFL, status & ~O_DIRECT);
+		return false;
+	}
+
+	// Returns room for at least n bytes, flushing first if needed.
+	char * reserve(const std::size_t n) {
+		if(capacity - used < n) {
+			flush();
+			if(capacity < n) grow(n);
+		}
+		return buffer + used;
+	}
+
+	void commit(const std::size_t n) { used += n; }
+
+	void put(const char * s, std::size_t n) {
+		// Whole buffers fill to the brim, splitting s across the seam.
+		while(whole() && capacity - used < n) {
+			const auto room = capacity - used;
+			std::memcpy(buffer + used, s, room);
+			used = capacity;
+			flush();
+			s += room;
+			n -= room;
+		}
+		std::memcpy(reserve(n), s, n);
+		used += n;
+	}
+
+	void put(const std::string_view s) { put(s.data(), s.size()); }
+
+	void put(const char c) {
+		*reserve(1) = c;
+		++used;
+	}
+
+	void integer(const long long v) {
+		char * first = reserve(20);
+		used += fixed_format::integer(first, v) - first;
+	}
+
+	template<typename T>
+	void little_endian(const T v, const std::size_t size = sizeof(T)) {
+		char bytes[sizeof(T)];
+		::little_endian(bytes, v, size);
+		put(bytes, size);
+	}
+
+	void decimal(const long long k, const int precision) {
+		char * first = reserve(48);
+		used += fixed_format::scaled(first, k, precision) - first;
+	}
+
+	// Same text as std::fixed with the given precision.
+	void fixed(const long double v, const int precision) {
+		char * first = reserve(64);
+		if(precision == 0 && std::fabs(v) < 9e18L && v == static_cast<long long>(v)) {
+			if(std::signbit(v)) *first++ = '-', ++used;
+			used += fixed_format::integer(first, static_cast<fixed_format::u64>(std::fabs(v))) - first;
+			return;
+		}
+		if(char * last = fixed_format::format(first, v, precision)) {
+			used += last - first;
+			return;
+		}
+		auto n = std::snprintf(first, 64, "%.*Lf", precision, v);
+		if(n >= 64) n = std::snprintf(reserve(n + 1), n + 1, "%.*Lf", precision, v);
+		used += n;
+	}
+
+	void flush() {
+		if(closed) {
+			used = 0;
+		} else if(ring) {
+			submit();
+		} else if(spliced && used == capacity) {
+			iovec pages{buffer, used};
+			while(pages.iov_len) {
+				const auto n = ::vmsplice(fd, &pages, 1, 0);
+				if(n < 0) {
+					if(errno == EINTR) continue;
+					used = 0;
+					if(errno == EPIPE) {
+						closed = true;
+						return;
+					}
+					throw std::system_error(errno, std::generic_category(), "vmsplice");
+				}
+				pages.iov_base = static_cast<char *>(pages.iov_base) + n;
+				pages.iov_len -= n;
+				offset += n;
+			}
+			select(current ^ 1);
+		} else {
+			const auto n = used;
+			used = 0;
+			write_all(buffer, n, -1);
+		}
+	}
+
+	// Flushes and waits for every queued write, so errors surface here.
+	void finish() {
+		flush();
+		drain();
+	}
+
+	// Whether the reader went away; everything written since is dropped.
+	bool broken() const { return closed; }
+
+	// Bytes handed to the descriptor so far.
+	unsigned long long position() const { return offset; }
+
+private:
+	static constexpr std::size_t page_size = 4096;
+
+	int fd;
+	std::size_t capacity;
+	std::unique_ptr<char, decltype(&std::free)> storage;
+	char * buffer = nullptr;
+	std::size_t used;
+	unsigned slots = 0, current = 0;
+	bool spliced = false, closed = false;
+
+	std::unique_ptr<io_ring> ring;
+	bool registered = false, direct = false;
+	unsigned long long offset = 0;
+	unsigned inflight = 0;
+	std::vector<unsigned> idle;
+	std::vector<std::size_t> lengths;
+	std::vector<unsigned long long> offsets;
+
+	bool whole() const { return spliced || ring; }
+
+	void allocate(const unsigned n) {
+		storage.reset(static_cast<char *>(std::aligned_alloc(page_size, n * capacity)));
+		if(!storage) throw std::bad_alloc();
+		slots = n;
+		select(0);
+	}
+
+	void select(const unsigned slot) {
+		current = slot;
+		buffer = storage.get() + slot * capacity;
+		used = 0;
+	}
+
+	// Every slot but the one being filled is free.
+	void release() {
+		idle.clear();
+		for(unsigned i = slots; i-- > 0;)
+			if(i != current) idle.push_back(i);
+	}
+
+	// Registers the buffers with the ring, so writes skip mapping them.
+	void register_storage() {
+		std::vector<iovec> buffers(slots);
+		for(unsigned i = 0; i < slots; ++i) buffers[i] = {storage.get() + i * capacity, capacity};
+		registered = ring->register_buffers(buffers);
+	}
+
+	void grow(const std::size_t n) {
+		drain();
+		// The old buffers stay pinned while registered, so let go of them
+		// before they are freed.
+		if(registered) ring->unregister_buffers();
+		registered = false;
+		capacity = (n + page_size - 1) / page_size * page_size;
+		allocate(slots);
+		release();
+		if(ring) register_storage();
+	}
+
+	// Writes at offset, or at the file position when offset is negative.
+	void write_all(const char * data, std::size_t n, long long at) {
+		while(n) {
+			const auto done = at < 0 ? ::write(fd, data, n) : ::pwrite(fd, data, n, at);
+			if(done < 0) {
+				if(errno == EINTR) continue;
+				if(errno == EPIPE) {
+					closed = true;
+					return;
+				}
+				throw std::system_error(errno, std::generic_category(), "write");
+			}
+			data += done;
+			n -= done;
+			if(at >= 0) at += done;
+			else offset += done;
+		}
+	}
+
+	// Queues the buffer and moves on to an idle one, waiting for the oldest
+	// write when all of them are in flight.
+	void submit() {
+		const std::size_t tail = direct ? used % page_size : 0;
+		const std::size_t n = used - tail;
+		if(n) {
+			ring->write(fd, buffer, n, offset, registered ? static_cast<int>(current) : -1, current);
+			lengths[current] = n;
+			offsets[current] = offset;
+			offset += n;
+			profile.io_peak = std::max<unsigned long long>(profile.io_peak, ++inflight);
+		} else {
+			idle.push_back(current);
+		}
+		if(tail) {
+			drain();
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			direct = false;
+			write_all(buffer + n, tail, offset);
+			offset += tail;
+		}
+		if(idle.empty()) {
+			const auto start = std::chrono::steady_clock::now();
+			complete(ring->wait());
+			++profile.io_stalls;
+			profile.io_stall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+		}
+		select(idle.back());
+		idle.pop_back();
+	}
+
+	void complete(const io_uring_cqe & cqe) {
+		const auto slot = static_cast<unsigned>(cqe.user_data);
+		--inflight;
+		idle.push_back(slot);
+		if(cqe.res < 0) throw std::system_error(-cqe.res, std::generic_category(), "io_uring write");
+		// A short write finishes synchronously; they are rare on files.
+		const auto done = static_cast<std::size_t>(cqe.res);
+		if(done < lengths[slot])
+			write_all(storage.get() + slot * capacity + done, lengths[slot] - done, offsets[slot] + done);
+	}
+
+	void drain() {
+		while(inflight) complete(ring->wait());
+	}
+};
+
+enum class output_format { text, raw_f32, raw_f64, raw_f80, raw_i64, csv, ndjson, json };
+// Bytes per value, by output_format; 0 for text.
+static constexpr unsigned char format_sizes[] = {0, 4, 8, 10, 8, 0, 0, 0};
+
+bool binary(const output_format format) { return format_sizes[static_cast<int>(format)] != 0; }
+
+// Fields of --emit-summary files, little-endian and in order, with long
+// doubles as their 10 x87 bytes so that summaries merge without rounding.
+class summary_writer {
+public:
+	template<typename T>
+	void put(const T v, const std::size_t size = sizeof(T)) {
+		char bytes[sizeof(T)];
+		::little_endian(bytes, v, size);
+		data.append(bytes, size);
+	}
+	void put(const long double v) { put<long double>(v, 10); }
+	void put(const std::string & s) {
+		put<std::uint32_t>(s.size());
+		data += s;
+	}
+
+	std::string data;
+};
+
+// Reads back what summary_writer wrote; running out of data throws.
+class summary_reader {
+public:
+	explicit summary_reader(std::string data) : data(std::move(data)) {}
+
+	template<typename T>
+	T get(const std::size_t size = sizeof(T)) {
+		T v{};
+		std::memcpy(&v, take(size), size);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::reverse(reinterpret_cast<char *>(&v), reinterpret_cast<char *>(&v) + size);
+#endif
+		return v;
+	}
+	long double real() { return get<long double>(10); }
+	std::string text() {
+		const auto size = get<std::uint32_t>();
+		return std::string(take(size), size);
+	}
+	bool done() const { return at == data.size(); }
+
+private:
+	std::string data;
+	std::size_t at = 0;
+
+	const char * take(const std::size_t size) {
+		if(data.size() - at < size) throw std::runtime_error("summary is truncated");
+		at += size;
+		return data.data() + at - size;
+	}
+};
+
+// Count, mean, sum of squared deviations, min and max of a stream, in
+// constant memory. Each batch is summarized on its own by of() and folded in
+// by merge(), which combines two summaries as Chan et al. do.
+class running_stats {
+public:
+	// Summarizes value(x) over [first, last) in two fused passes: min, max and
+	// a compensated sum, then the squared deviations from that mean with the
+	// rounding of the mean corrected for. long double has no vector
+	// registers, and splitting the passes into lanes only spills the x87
+	// stack, so each pass is one chain. With higher, the second pass also
+	// sums the third and fourth powers for skewness and kurtosis.
+	template<bool higher = false, typename It, typename F>
+	static running_stats of(const It first, const It last, F value) {
+		running_stats s;
+		s.n = last - first;
+		s.higher = higher;
+		if(s.n == 0) return s;
+
+		long double sum = 0, carry = 0;
+		for(It i = first; i != last; ++i) {
+			const long double v = value(*i);
+			add_compensated(sum, carry, v);
+			s.lo = std::min(s.lo, v);
+			s.hi = std::max(s.hi, v);
+		}
+		s.mu = (sum - carry) / s.n;
+
+		long double squares = 0, drift = 0, cubes = 0, fourths = 0;
+		for(It i = first; i != last; ++i) {
+			const long double d = value(*i) - s.mu, d2 = d * d;
+			squares += d2;
+			drift += d;
+			if constexpr(higher) {
+				cubes += d2 * d;
+				fourths += d2 * d2;
+			}
+		}
+		// Sums of powers of d - e, e being what the deviations average.
+		const long double e = drift / s.n;
+		s.m2 = std::max(0.0L, squares - drift * drift / s.n);
+		if constexpr(higher) {
+			s.m3 = cubes - 3 * e * squares + 2 * s.n * e * e * e;
+			s.m4 = std::max(0.0L, fourths - 4 * e * cubes + 6 * e * e * squares - 3 * s.n * e * e * e * e);
+		}
+		return s;
+	}
+
+	// Chan et al. for the mean and m2, Pebay for m3 and m4.
+	void merge(const running_stats & other) {
+		if(other.n == 0) return;
+		const long double a = n, b = other.n, total = a + b;
+		const long double delta = other.mu - mu, shift = delta / total;
+		m4 += other.m4 + delta * delta * delta * shift * a * b * (a * a - a * b + b * b) / (total * total)
+			+ 6 * shift * shift * (a * a * other.m2 + b * b * m2) + 4 * shift * (a * other.m3 - b * m3);
+		m3 += other.m3 + delta * delta * shift * a * b * (a - b) / total
+			+ 3 * shift * (a * other.m2 - b * m2);
+		mu += delta * other.n / total;
+		m2 += other.m2 + delta * delta * n * other.n / total;
+		higher = (n == 0 || higher) && other.higher;
+		n += other.n;
+		lo = std::min(lo, other.lo);
+		hi = std::max(hi, other.hi);
+	}
+
+	void save(summary_writer & to) const {
+		to.put<long long>(n);
+		to.put<std::uint8_t>(higher);
+		for(const auto v : {mu, m2, m3, m4, lo, hi}) to.put(v);
+	}
+
+	static running_stats load(summary_reader & from) {
+		running_stats s;
+		s.n = from.get<long long>();
+		s.higher = from.get<std::uint8_t>();
+		for(auto * v : {&s.mu, &s.m2, &s.m3, &s.m4, &s.lo, &s.hi}) *v = from.real();
+		return s;
+	}
+
+	long long count() const { return n; }
+	long double mean() const { return n ? mu : nan(); }
+	long double variance() const { return n ? m2 / n : nan(); }
+	long double min() const { return n ? lo : nan(); }
+	long double max() const { return n ? hi : nan(); }
+	// Population skewness and excess kurtosis; NaN unless summed with higher.
+	long double skewness() const { return n && higher ? std::sqrt(n) * m3 / std::pow(m2, 1.5L) : nan(); }
+	long double kurtosis() const { return n && higher ? n * m4 / (m2 * m2) - 3 : nan(); }
+
+private:
+	long long n = 0;
+	bool higher = false;
+	long double mu = 0, m2 = 0, m3 = 0, m4 = 0;
+	long double lo = std::numeric_limits<long double>::infinity();
+	long double hi = -std::numeric_limits<long double>::infinity();
+
+	static long double nan() { return std::numeric_limits<long double>::quiet_NaN(); }
+
+	// Kahan summation; sum - carry is the sum with its rounding error removed.
+	static void add_compensated(long double & sum, long double & carry, const long double v) {
+		const long double y = v - carry;
+		const long double t = sum + y;
+		carry = (t - sum) - y;
+		sum = t;
+	}
+};
+
+// Quantile q of values, linear between the order statistics around
+// q (n - 1), which for q = 0.5 is the usual median. Reorders values.
+long double exact_quantile(std::vector<long double> & values, const long double q) {
+	if(values.empty()) return std::numeric_limits<long double>::quiet_NaN();
+	const long double position = q * (values.size() - 1);
+	const auto i = static_cast<std::size_t>(position);
+	const auto nth = values.begin() + i;
+	std::nth_element(values.begin(), nth, values.end());
+	const long double f = position - i;
+	if(f == 0) return *nth;
+	return *nth * (1 - f) + *std::min_element(nth + 1, values.end()) * f;
+}
+
+// Exact order statistics by MSD radix select. The sign, exponent and
+// fraction of an x87 long double are rearranged into a 79-bit key that
+// sorts like the values; each pass counts one digit of the candidates on
+// every thread, keeps only the buckets holding a wanted rank and starts
+// over on those, so all the ranks of a query share the passes. Small
+// candidate sets finish with nth_element.
+class radix_select {
+public:
+	static constexpr bool supported = std::numeric_limits<long double>::digits == 64;
+
+	explicit radix_select(const unsigned threads) : threads(std::max(1u, threads)) {}
+
+	// The values at the given ranks of values, as if sorted.
+	std::vector<long double> operator()(const std::vector<long double> & values,
+			const std::vector<std::size_t> & ranks) const {
+		std::vector<long double> out(ranks.size());
+		std::vector<wanted> all;
+		for(std::size_t slot = 0; slot < ranks.size(); ++slot) all.push_back({ranks[slot], slot});
+		std::sort(all.begin(), all.end());
+		select(values.data(), values.size(), all, 0, out);
+		return out;
+	}
+
+private:
+	using key_type = unsigned __int128;
+	struct wanted {
+		std::size_t rank, slot;
+		bool operator<(const wanted & other) const { return rank < other.rank; }
+	};
+	// Digits from the top of the key, which sits in the top 79 bits; the
+	// first is wide enough to split the exponents of uniform draws.
+	struct digit { int shift, width; };
+	static constexpr digit digits[] = {{108, 20}, {92, 16}, {76, 16}, {60, 16}, {49, 11}};
+	static constexpr std::size_t small = 1 << 15;
+
+	unsigned threads;
+
+	static key_type key(const long double v) {
+		std::uint64_t fraction;
+		std::uint16_t exponent;
+		std::memcpy(&fraction, &v, 8);
+		std::memcpy(&exponent, reinterpret_cast<const char *>(&v) + 8, 2);
+		// The explicit integer bit repeats what the exponent says; drop it.
+		key_type k = static_cast<key_type>(exponent) << 63 | (fraction & ~(1ull << 63));
+		k = exponent & 0x8000 ? ~k : k | static_cast<key_type>(1) << 78;
+		return k << 49;
+	}
+
+	static std::size_t bucket(const long double v, const digit d) {
+		return static_cast<std::size_t>(key(v) >> d.shift) & ((std::size_t(1) << d.width) - 1);
+	}
+
+	// Runs f(t, first, last) on one thread per slice of [0, n).
+	template<typename F>
+	void parallel(const std::size_t n, const unsigned workers, F f) const {
+		if(workers == 1) return f(0u, std::size_t(0), n);
+		std::vector<std::thread> pool;
+		for(unsigned t = 0; t < workers; ++t)
+			pool.emplace_back(f, t, n * t / workers, n * (t + 1) / workers);
+		for(auto & thread : pool) thread.join();
+	}
+
+	void select(const long double * data, const std::size_t n, const std::vector<wanted> & ranks,
+			const std::size_t level, std::vector<long double> & out) const {
+		if(level == std::size(digits)) {
+			// Every key is the same; so is every value.
+			for(const auto & w : ranks) out[w.slot] = data[0];
+			return;
+		}
+		if(n <= small) {
+			std::vector<long double> copy(data, data + n);
+			auto first = copy.begin();
+			for(const auto & w : ranks) {
+				std::nth_element(first, copy.begin() + w.rank, copy.end());
+				first = copy.begin() + w.rank;
+				out[w.slot] = *first;
+			}
+			return;
+		}
+
+		const digit d = digits[level];
+		const std::size_t buckets = std::size_t(1) << d.width;
+		const unsigned workers = std::min<std::size_t>(threads, n / small);
+		std::vector<std::vector<std::size_t> > counts(workers, std::vector<std::size_t>(buckets));
+		parallel(n, workers, [&](const unsigned t, const std::size_t first, const std::size_t last) {
+			auto & count = counts[t];
+			for(std::size_t i = first; i < last; ++i) ++count[bucket(data[i], d)];
+		});
+
+		// Find the bucket of each rank; ranks in one bucket form one group.
+		struct group { std::size_t bucket, size; std::vector<wanted> ranks; };
+		std::vector<group> groups;
+		std::vector<int> group_of(buckets, -1);
+		std::size_t below = 0, b = 0, total = 0;
+		for(const auto & w : ranks) {
+			for(;; ++b, below += total) {
+				total = 0;
+				for(const auto & count : counts) total += count[b];
+				if(w.rank < below + total) break;
+			}
+			if(group_of[b] < 0) {
+				group_of[b] = groups.size();
+				groups.push_back({b, total, {}});
+			}
+			groups[group_of[b]].ranks.push_back({w.rank - below, w.slot});
+		}
+
+		// Each thread copies its candidates to its own offsets in the groups.
+		std::vector<std::vector<long double> > candidates(groups.size());
+		std::vector<std::vector<std::size_t> > offsets(workers, std::vector<std::size_t>(groups.size()));
+		for(std::size_t g = 0; g < groups.size(); ++g) {
+			candidates[g].resize(groups[g].size);
+			for(unsigned t = 1; t < workers; ++t)
+				offsets[t][g] = offsets[t - 1][g] + counts[t - 1][groups[g].bucket];
+		}
+		counts.clear();
+		parallel(n, workers, [&](const unsigned t, const std::size_t first, const std::size_t last) {
+			auto & offset = offsets[t];
+			for(std::size_t i = first; i < last; ++i) {
+				const int g = group_of[bucket(data[i], d)];
+				if(g >= 0) candidates[g][offset[g]++] = data[i];
+			}
+		});
+
+		for(std::size_t g = 0; g < groups.size(); ++g) {
+			select(candidates[g].data(), candidates[g].size(), groups[g].ranks, level + 1, out);
+			std::vector<long double>().swap(candidates[g]);
+		}
+	}
+};
+
+// Quantiles qs of values, interpolated as exact_quantile does, with one
+// radix select for all of them where long double is x87.
+std::vector<long double> exact_quantiles(std::vector<long double> & values,
+		const std::vector<long double> & qs, const unsigned threads) {
+	std::vector<long double> result;
+	if(values.empty() || !radix_select::supported) {
+		for(const auto q : qs) result.push_back(exact_quantile(values, q));
+		return result;
+	}
+	std::vector<std::size_t> ranks;
+	for(const auto q : qs) {
+		const long double position = q * (values.size() - 1);
+		const auto i = static_cast<std::size_t>(position);
+		ranks.push_back(i);
+		ranks.push_back(std::min(i + 1, values.size() - 1));
+	}
+	const auto order = radix_select(threads)(values, ranks);
+	for(std::size_t j = 0; j < qs.size(); ++j) {
+		const long double position = qs[j] * (values.size() - 1);
+		const long double f = position - ranks[2 * j];
+		result.push_back(f == 0 ? order[2 * j] : order[2 * j] * (1 - f) + order[2 * j + 1] * f);
+	}
+	return result;
+}
+
+// Mean, variance, min and max of the last n values of a stream, each in
+// O(1) per value: the moments move by the value in and the value out, and
+// min and max are the fronts of monotonic deques. The moments are summed
+// afresh each time the window turns over, so rounding does not pile up.
+class rolling_stats {
+public:
+	explicit rolling_stats(const long long n) : ring(std::max(1ll, n)), inverse(1.0L / ring.size()) {}
+
+	void add(const long double v) {
+		const long long n = ring.size(), i = seen++;
+		while(!lows.empty() && lows.back().second >= v) lows.pop_back();
+		while(!highs.empty() && highs.back().second <= v) highs.pop_back();
+		lows.emplace_back(i, v);
+		highs.emplace_back(i, v);
+		if(lows.front().first + n <= i) lows.pop_front();
+		if(highs.front().first + n <= i) highs.pop_front();
+
+		auto & slot = ring[next];
+		const long double before = mu;
+		if(i < n) {
+			mu += (v - before) / (i + 1);
+			m2 += (v - before) * (v - mu);
+		} else {
+			mu += (v - slot) * inverse;
+			m2 = std::max(0.0L, m2 + (v - slot) * (v - mu + slot - before));
+		}
+		slot = v;
+
+		if(++next == ring.size()) {
+			next = 0;
+			const auto exact = running_stats::of(ring.begin(), ring.end(), [](const long double x) { return x; });
+			mu = exact.mean();
+			m2 = exact.variance() * n;
+		}
+	}
+
+	long long total() const { return seen; }
+	long long count() const { return std::min<long long>(seen, ring.size()); }
+	long double mean() const { return seen ? mu : nan(); }
+	long double variance() const { return seen ? m2 / count() : nan(); }
+	long double min() const { return seen ? lows.front().second : nan(); }
+	long double max() const { return seen ? highs.front().second : nan(); }
+
+private:
+	std::vector<long double> ring;
+	long double inverse;
+	std::size_t next = 0;
+	std::deque<std::pair<long long, long double> > lows, highs;
+	long long seen = 0;
+	long double mu = 0, m2 = 0;
+
+	static long double nan() { return std::numeric_limits<long double>::quiet_NaN(); }
+};
+
+// KLL sketch (Karnin, Lang and Liberty) of a stream's quantiles: about 4k
+// values whatever the count, a rank error of about 2/k, and two sketches
+// merge into the sketch of both streams. Level h holds values standing for
+// 2^h draws each; a full level is sorted and every other value, from a
+// random start, moves up. Levels above 0 are kept sorted, so only the
+// buffer of new values is ever sorted whole.
+class quantile_sketch {
+public:
+	explicit quantile_sketch(const int k = 200) : k(k), levels(1) {}
+
+	void add(const long double v) {
+		levels[0].push_back(v);
+		++n;
+		if(levels[0].size() >= static_cast<std::size_t>(k)) compress();
+	}
+
+	void merge(const quantile_sketch & other) {
+		if(other.levels.size() > levels.size()) levels.resize(other.levels.size());
+		for(std::size_t h = 0; h < other.levels.size(); ++h)
+			append(levels[h], other.levels[h].begin(), other.levels[h].end(), h > 0);
+		n += other.n;
+		compress();
+	}
+
+	unsigned long long count() const { return n; }
+
+	void save(summary_writer & to) const {
+		to.put<std::int32_t>(k);
+		to.put<std::uint64_t>(n);
+		to.put<std::uint32_t>(levels.size());
+		for(const auto & level : levels) {
+			to.put<std::uint64_t>(level.size());
+			for(const auto v : level) to.put(v);
+		}
+	}
+
+	static quantile_sketch load(summary_reader & from) {
+		const auto k = from.get<std::int32_t>();
+		if(k < 2) throw std::runtime_error("sketch size is invalid");
+		quantile_sketch s(k);
+		s.n = from.get<std::uint64_t>();
+		const auto height = from.get<std::uint32_t>();
+		if(height == 0 || height > 64) throw std::runtime_error("sketch height is invalid");
+		s.levels.resize(height);
+		for(auto & level : s.levels) {
+			for(auto size = from.get<std::uint64_t>(); size > 0; --size) level.push_back(from.real());
+			std::sort(level.begin(), level.end());
+		}
+		return s;
+	}
+
+	long double quantile(const long double q) const {
+		if(n == 0) return std::numeric_limits<long double>::quiet_NaN();
+		std::vector<std::pair<long double, unsigned long long> > items;
+		for(std::size_t h = 0; h < levels.size(); ++h)
+			for(const auto v : levels[h]) items.emplace_back(v, 1ull << h);
+		std::sort(items.begin(), items.end());
+		const long double rank = q * n;
+		unsigned long long seen = 0;
+		for(const auto & item : items)
+			if((seen += item.second) >= rank) return item.first;
+		return items.back().first;
+	}
+
+private:
+	int k;
+	std::vector<std::vector<long double> > levels;
+	unsigned long long n = 0;
+	unsigned long long bits = 0x9e3779b97f4a7c15ull;
+
+	// Capacities shrink by 2/3 per level below the top, to at least 2; level
+	// 0 is a buffer of k values so compactions come in batches.
+	std::size_t capacity(const std::size_t h) const {
+		if(h == 0) return k;
+		return std::max<std::size_t>(2, std::ceil(k * std::pow(2.0 / 3, levels.size() - 1 - h)));
+	}
+
+	template<typename It>
+	static void append(std::vector<long double> & to, const It first, const It last, const bool sorted) {
+		const auto middle = to.size();
+		to.insert(to.end(), first, last);
+		if(sorted) std::inplace_merge(to.begin(), to.begin() + middle, to.end());
+	}
+
+	// Compacts every full level, bottom up. An odd value out stays behind.
+	void compress() {
+		std::vector<long double> up;
+		for(std::size_t h = 0; h < levels.size(); ++h) {
+			auto & from = levels[h];
+			if(from.size() < capacity(h)) continue;
+			if(h == 0) std::sort(from.begin(), from.end());
+			bits ^= bits << 13, bits ^= bits >> 7, bits ^= bits << 17;
+			const std::size_t even = from.size() & ~std::size_t(1);
+			up.clear();
+			for(std::size_t i = bits & 1; i < even; i += 2) up.push_back(from[i]);
+			from.erase(from.begin(), from.begin() + even);
+			if(h + 1 == levels.size()) levels.emplace_back();
+			append(levels[h + 1], up.begin(), up.end(), true);
+		}
+	}
+};
+
+// Counts of values in equal-width bins over [lo, hi). An exact histogram
+// counts each integer lo..hi - 1 on its own and folds the counts into bins
+// when read. Counts are spread over interleaved lanes so that runs of one
+// value do not wait on the same counter, and summed when read. Values
+// below lo or above hi, which only --analyze input can hold, are counted
+// apart rather than in the edge bins.
+class histogram {
+public:
+	// Exact ranges are capped like number_table: each value costs a counter
+	// per lane up front.
+	static constexpr long long max_exact = 1 << 16;
+
+	struct bin {
+		long double lower, upper;
+		unsigned long long count;
+		bool single;	// holds one integer, lower
+	};
+
+	histogram(const long long bins, const long double lo, const long double hi, const bool exact)
+		: bins(bins), lo(lo), hi(hi), exact(exact),
+		cells(exact ? static_cast<std::size_t>(hi - lo) : bins),
+		scale(hi > lo ? bins / (hi - lo) : 0), counts(cells * lanes) {}
+
+	template<typename It, typename F>
+	void add(It first, const It last, F value) {
+		for(; last - first >= lanes; first += lanes)
+			for(int lane = 0; lane < lanes; ++lane)
+				count(value(first[lane]), lane);
+		for(; first != last; ++first) count(value(*first), 0);
+	}
+
+	// Folds in a histogram with the same bins; false if they differ.
+	bool merge(const histogram & other) {
+		if(bins != other.bins || lo != other.lo || hi != other.hi || exact != other.exact) return false;
+		for(std::size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+		below += other.below;
+		above += other.above;
+		return true;
+	}
+
+	unsigned long long under() const { return below; }
+	unsigned long long over() const { return above; }
+
+	void save(summary_writer & to) const {
+		to.put<std::uint64_t>(bins);
+		to.put(lo);
+		to.put(hi);
+		to.put<std::uint8_t>(exact);
+		for(std::size_t c = 0; c < cells; ++c) {
+			unsigned long long count = 0;
+			for(int lane = 0; lane < lanes; ++lane) count += counts[c * lanes + lane];
+			to.put<std::uint64_t>(count);
+		}
+		to.put<std::uint64_t>(below);
+		to.put<std::uint64_t>(above);
+	}
+
+	static histogram load(summary_reader & from) {
+		const auto bins = from.get<std::uint64_t>();
+		const auto lo = from.real(), hi = from.real();
+		const bool exact = from.get<std::uint8_t>();
+		if(bins == 0 || bins > 1 << 24 || (exact && !(hi - lo >= 1 && hi - lo <= max_exact)))
+			throw std::runtime_error("histogram bins are invalid");
+		histogram h(bins, lo, hi, exact);
+		for(std::size_t c = 0; c < h.cells; ++c) h.counts[c * lanes] = from.get<std::uint64_t>();
+		h.below = from.get<std::uint64_t>();
+		h.above = from.get<std::uint64_t>();
+		return h;
+	}
+
+	std::vector<bin> read() const {
+		std::vector<bin> out;
+		const std::size_t shown = exact ? std::min<std::size_t>(bins, cells) : cells;
+		for(std::size_t c = 0; c < cells; ++c) {
+			const std::size_t b = exact ? c * shown / cells : c;
+			if(out.size() <= b) {
+				const long double lower = exact ? lo + c : lo + (hi - lo) * b / bins;
+				out.push_back({lower, lower, 0, exact});
+			}
+			out[b].upper = exact ? lo + c + 1 : lo + (hi - lo) * (b + 1) / bins;
+			out[b].single = exact && out[b].upper == out[b].lower + 1;
+			for(int lane = 0; lane < lanes; ++lane) out[b].count += counts[c * lanes + lane];
+		}
+		// Values out of range follow as open-ended bins, when there are any.
+		const long double inf = std::numeric_limits<long double>::infinity();
+		if(below) out.push_back({-inf, lo, below, false});
+		if(above) out.push_back({hi, inf, above, false});
+		return out;
+	}
+
+	// The value counted most in an exact histogram, the smallest of a tie,
+	// and its count; read straight off the lanes so that no bins are built.
+	std::pair<long double, unsigned long long> peak() const {
+		std::pair<long double, unsigned long long> best{std::numeric_limits<long double>::quiet_NaN(), 0};
+		for(std::size_t c = 0; c < cells; ++c) {
+			unsigned long long count = 0;
+			for(int lane = 0; lane < lanes; ++lane) count += counts[c * lanes + lane];
+			if(count > best.second) best = {lo + c, count};
+		}
+		return best;
+	}
+
+private:
+	static constexpr int lanes = 4;
+	std::size_t bins;
+	long double lo, hi;
+	bool exact;
+	std::size_t cells;
+	long double scale;
+	std::vector<unsigned long long> counts;
+	unsigned long long below = 0, above = 0;
+
+	// Exact histograms only see drawn numbers, which are always in range.
+	void count(const long double v, const int lane) {
+		if(!exact && v < lo) ++below;
+		else if(!exact && v > hi) ++above;
+		else ++counts[cell(v) * lanes + lane];
+	}
+
+	std::size_t cell(const long double v) const {
+		// Exact offsets are whole, so they narrow to double, which converts
+		// to an integer far faster than long double does.
+		if(exact) return clamp(static_cast<double>(v - lo));
+		return clamp((v - lo) * scale);
+	}
+
+	template<typename T>
+	std::size_t clamp(const T offset) const {
+		if(!(offset > 0)) return 0;
+		return std::min(static_cast<std::size_t>(offset), cells - 1);
+	}
+};
+
+// How often each value comes, for --stat-mode: an exact histogram of one
+// bin per value over integer ranges, otherwise an open-addressing hash
+// table, which unlike a node-based map does not allocate per value.
+class value_counts {
+public:
+	value_counts(const long double lo, const long double hi, const bool exact) {
+		if(exact) table.emplace(hi - lo, lo, hi, true);
+	}
+
+	template<typename It, typename F>
+	void add(It first, const It last, F value) {
+		if(table) return table->add(first, last, value);
+		for(; first != last; ++first) bump(value(*first), 1);
+	}
+
+	void merge(const value_counts & other) {
+		if(table) table->merge(*other.table);
+		else for(const auto & [v, count] : other.slots) if(count) bump(v, count);
+	}
+
+	// The most frequent value, the smallest of a tie; NaN if none came.
+	long double mode() const {
+		if(table) return table->peak().first;
+		long double best = std::numeric_limits<long double>::quiet_NaN();
+		unsigned long long most = 0;
+		const auto offer = [&](const long double v, const unsigned long long count) {
+			if(count > most || (count == most && count > 0 && v < best)) best = v, most = count;
+		};
+		for(const auto & [v, count] : slots) offer(v, count);
+		return best;
+	}
+
+private:
+	std::optional<histogram> table;
+	// Linear probing over a power of two of slots, at most half full; a
+	// count of 0 marks a free slot.
+	std::vector<std::pair<long double, unsigned long long> > slots = decltype(slots)(16);
+	std::size_t used = 0;
+
+	static std::size_t hash(const long double v) {
+		std::uint64_t fraction = 0;
+		std::uint16_t exponent = 0;
+		if(v != 0) {	// 0 and -0 are equal, so must hash alike
+			std::memcpy(&fraction, &v, 8);
+			std::memcpy(&exponent, reinterpret_cast<const char *>(&v) + 8, 2);
+		}
+		const std::uint64_t h = (fraction ^ std::uint64_t(exponent) << 48) * 0x9e3779b97f4a7c15ull;
+		return h ^ h >> 29;
+	}
+
+	void bump(const long double v, const unsigned long long by) {
+		if(2 * (used + 1) > slots.size()) {
+			auto old = std::move(slots);
+			slots.assign(old.size() * 2, {});
+			used = 0;
+			for(const auto & [w, count] : old) if(count) bump(w, count);
+		}
+		const std::size_t mask = slots.size() - 1;
+		for(std::size_t i = hash(v) & mask;; i = (i + 1) & mask) {
+			auto & slot = slots[i];
+			if(slot.second == 0) {
+				slot = {v, by};
+				++used;
+				return;
+			}
+			if(slot.first == v) {
+				slot.second += by;
+				return;
+			}
+		}
+	}
+};
+
+// The k largest values, for --stat-topk, in a min-heap of at most k.
+class top_values {
+public:
+	explicit top_values(const std::size_t k) : k(k) {}
+
+	template<typename It, typename F>
+	void add(It first, const It last, F value) {
+		for(; first != last; ++first) {
+			const long double v = value(*first);
+			if(heap.size() < k) {
+				heap.push_back(v);
+				std::push_heap(heap.begin(), heap.end(), std::greater<>());
+			} else if(k > 0 && v > heap.front()) {
+				std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+				heap.back() = v;
+				std::push_heap(heap.begin(), heap.end(), std::greater<>());
+			}
+		}
+	}
+
+	void merge(const top_values & other) {
+		add(other.heap.begin(), other.heap.end(), [](const long double v) { return v; });
+	}
+
+	// Largest first.
+	std::vector<long double> values() const {
+		auto sorted = heap;
+		std::sort(sorted.begin(), sorted.end(), std::greater<>());
+		return sorted;
+	}
+
+private:
+	std::size_t k;
+	std::vector<long double> heap;
 };
 
 struct program_args {
 	// general
 	int precision;
-	bool quiet, list, numbers_force, flags;
+	bool quiet, list, numbers_force, flags, profile;
 	std::string delim = "\n";
+	long long batch_size, bench_format, bytes = 0;
+	std::string trace, format_name, output;
+	output_format format = output_format::text;
+	bool header, splice, direct, mmap;
+	int threads;
 	// intern
 	long long number;
+	// --number inf: number is the largest long long, never reached.
+	std::string number_text;
+	bool endless = false;
 	long double lbound, ubound;
 	std::string generator;
+	unsigned long long seed;
+	bool decimal;
+	// With --decimal numbers are generated as integers k in units of
+	// 10^-precision; otherwise the unit is 1.
+	long long decimal_min, decimal_max;
+	long double unit = 1;
 	// rounding
 	bool ceil, floor, round, trunc;
 	// matcher
 	std::vector<long double> excluded, included;
+	std::vector<long double> excluded_units, included_units;
 	bool norepeat;
-	std::vector<std::string> prefix, suffix, contains;
+	std::vector<std::string> prefix, suffix, contains, match;
+	pattern_automaton patterns;
+	digit_dfa matcher;
+	digit_sampler sampler;
 	// stats
 	bool stat_all, stat_min, stat_max, stat_median,
-		stat_avg, stat_var, stat_std, stat_coef;
+		stat_avg, stat_var, stat_std, stat_coef, stat_skew, stat_kurt, stat_mode;
+	long long stat_topk;
+	std::vector<std::string> stat_quantile;
+	std::vector<long double> quantiles;
+	long double sketch_error;
+	long long stat_hist;
+	std::string emit_summary;
+	std::vector<std::string> merge;
+	std::string input;
+	long long stat_window, stat_every;
+	// analysis
+	long double acceptance = 1, expected_draws = 1;
+	bool acceptance_exact = true;
+	// Distinct values that can pass, for --norepeat; zero means unbounded.
+	long double capacity = 0;
+};
+
+returnID check_feasibility(program_args & args);
+std::pair<long double, long double> count_range(const program_args & args);
+
+returnID parse_args(program_args & args, int argc, char const * const * argv) {
+	static auto const ld_prec = std::numeric_limits<long double>::max_digits10;
+
+	namespace po = boost::program_options;
+	po::options_description general("General options");
+	general.add_options()
+		("help,h", "produce this help message")
+		("precision,p", po::value<int>(&args.precision)->default_value(ld_prec), 
+			"output precision (not internal precision)")
+		("quiet,q", po::bool_switch(&args.quiet)->default_value(false),
+			"disable number output, useful with stats")
+		("format", po::value<std::string>(&args.format_name)->default_value("text"),
+			"output format: text; csv, ndjson or json with --list indices as "
+			"fields and, for ndjson and json, stats and flags in a trailer; or "
+			"native little-endian binary values with no delimiters: raw-f32, "
+			"raw-f64, raw-f80, raw-i64 (needs rounding or --decimal; writes k "
+			"under --decimal). Reports go to stderr for csv and binary")
+		("header", po::bool_switch(&args.header)->default_value(false),
+			"start raw output with a 24-byte header: \"DRAW\", version, type, "
+			"value size, 0, count (all ones if unknown), seed; integers little-endian")
+		("output,o", po::value<std::string>(&args.output),
+			"write the numbers to a file instead of stdout, through io_uring "
+			"when the kernel has it")
+		("direct", po::bool_switch(&args.direct)->default_value(false),
+			"open --output with O_DIRECT, bypassing the page cache; raw "
+			"formats and --bytes only")
+		("mmap", po::bool_switch(&args.mmap)->default_value(false),
+			"size --output for every number and write it through a shared "
+			"mapping; raw formats where every draw is kept")
+		("threads", po::value<int>(&args.threads)->default_value(1),
+			"--mmap threads, each drawing a slice with its own engine seeded "
+			"from --seed and its index, and threads for --analyze and for "
+			"exact medians and quantiles; 0 uses every core")
+		("splice", po::bool_switch(&args.splice)->default_value(false),
+			"hand raw output and --bytes to a stdout pipe with vmsplice instead "
+			"of copying it; the reader must read, not splice, the data. Falls "
+			"back to write on files and ttys")
+		("list", po::bool_switch(&args.list)->default_value(false),
+			"print numbers in a list")
+		("delim", po::value<std::string>(&args.delim),
+			"change the delimiter")
+		("numbers-force", po::bool_switch(&args.numbers_force)->default_value(false),
+			"force the count of numbers printed to be equal to --number")
+		("flags", po::bool_switch(&args.flags)->default_value(false),
+			"print the flags")
+		("profile", po::bool_switch(&args.profile)->default_value(false),
+			"print per-stage counters and timings as JSON on stderr")
+		("batch-size", po::value<long long>(&args.batch_size)->default_value(4096),
+			"numbers drawn, filtered and written per batch")
+		("trace", po::value<std::string>(&args.trace),
+			"write a trace-event JSON timeline of the run to a file")
+		("bench-format", po::value<long long>(&args.bench_format)->default_value(0),
+			"time the number formatter against std::ostream over N values and exit");
+
+	po::options_description intern("Internal RNG options");
+	intern.add_options()
+		("number,n", po::value<std::string>(&args.number_text)->default_value("1"),
+			"count of numbers to be generated, or inf to run until interrupted "
+			"or the reader goes away; medians and quantiles are then sketched")
+		("lbound,l", po::value<long double>(&args.lbound)->default_value(0.0),
+			"minimum number (ldouble)")
+		("ubound,u", po::value<long double>(&args.ubound)->default_value(1.0),
+			"maximum number (ldouble)")
+		("generator,g", po::value<std::string>(&args.generator)->default_value("mt19937"),
+			"change the RNG algorithm:\nminstd_rand0, minstd_rand"
+			"\nmt19937, mt19937_64\nranlux24_base, ranlux48_base"
+			"\nranlux24, ranlux48\nknuth_b, default_random_engine"
+			"\nbadrandom (std::rand)")
+		("seed", po::value<unsigned long long>(&args.seed),
+			"seed the generator (random by default)")
+		("bytes", po::value<std::string>(),
+			"write N raw bytes of generator output, or 'inf' for an endless "
+			"stream, and exit; bounds and filters do not apply")
+		("decimal", po::bool_switch(&args.decimal)->default_value(false),
+			"draw exact decimals with --precision places, uniform over that grid");
+
+	po::options_description rounding("Rounding options");
+	rounding.add_options()
+		("ceil,c", po::bool_switch(&args.ceil)->default_value(false),
+			"apply ceiling function")
+		("floor,f", po::bool_switch(&args.floor)->default_value(false),
+			"apply floor function")
+		("round,r", po::bool_switch(&args.round)->default_value(false),
+			"apply round function")
+		("trunc,t", po::bool_switch(&args.trunc)->default_value(false),
+			"apply truncation");
+
+	po::options_description matcher("Matcher options");
+	matcher.add_options()
+		("exclude", po::value<std::vector<long double> >(&args.excluded)->multitoken(), 
+			"print only the numbers not exactly specified, best with rounding")
+		("include", po::value<std::vector<long double> >(&args.included)->multitoken(),
+			"print only the numbers exactly specified, best with rounding ")
+		("norepeat", po::bool_switch(&args.norepeat)->default_value(false),
+			"exclude repeated numbers from being printed, best with rounding")
+		("prefix", po::value<std::vector<std::string> >(&args.prefix)->multitoken(),
+			"only print if the number begins with string(s)")
+		("suffix", po::value<std::vector<std::string> >(&args.suffix)->multitoken(),
+			"only print if the number ends with string(s)")
+		("contains", po::value<std::vector<std::string> >(&args.contains)->multitoken(),
+			"only print if the number contains string(s)")
+		("match", po::value<std::vector<std::string> >(&args.match)->multitoken(),
+			"only print if the whole number matches digit regex(es):\n"
+			"0-9 -, \\. point, \\d digit, . any, [...], (), |, * + ? {m,n}");
+
+	po::options_description stats("Statistics options");
+	stats.add_options()
+		("stat-all", po::bool_switch(&args.stat_all)->default_value(false),
+			"print all statistics")
+		("stat-min", po::bool_switch(&args.stat_min)->default_value(false), 
+			"print the minimum")
+		("stat-max", po::bool_switch(&args.stat_max)->default_value(false),
+			"print the maximum")
+		("stat-median", po::bool_switch(&args.stat_median)->default_value(false),
+			"print the median")
+		("stat-avg", po::bool_switch(&args.stat_avg)->default_value(false),
+			"print the average")
+		("stat-var", po::bool_switch(&args.stat_var)->default_value(false),
+			"print the variance")
+		("stat-std", po::bool_switch(&args.stat_std)->default_value(false),
+			"print the standard deviation")
+		("stat-coef", po::bool_switch(&args.stat_coef)->default_value(false),
+			"print the coefficient of variation")
+		("stat-skew", po::bool_switch(&args.stat_skew)->default_value(false),
+			"print the skewness")
+		("stat-kurt", po::bool_switch(&args.stat_kurt)->default_value(false),
+			"print the excess kurtosis")
+		("stat-mode", po::bool_switch(&args.stat_mode)->default_value(false),
+			"print the most frequent number, counting rounded and decimal numbers "
+			"per value and others in a hash map")
+		("stat-topk", po::value<long long>(&args.stat_topk)->default_value(0),
+			"print this many of the largest numbers")
+		("stat-quantile", po::value<std::vector<std::string> >(&args.stat_quantile)->multitoken(),
+			"print quantiles, given as a comma-separated list such as 0.5,0.9,0.99")
+		("sketch-error", po::value<long double>(&args.sketch_error)->default_value(0),
+			"estimate the median and quantiles from a bounded-memory sketch with "
+			"about this rank error (1e-6 to 1, e.g. 0.001) instead of keeping every number")
+		("stat-hist", po::value<long long>(&args.stat_hist)->default_value(0),
+			"print counts in this many equal-width bins over [lbound, ubound); "
+			"rounded and decimal numbers over at most 65536 values are counted value by value; with --merge, "
+			"prints the summaries' own bins")
+		("emit-summary", po::value<std::string>(&args.emit_summary),
+			"write a binary summary of the run to this file for --merge: count, "
+			"moments, min and max, a quantile sketch (see --sketch-error, "
+			"0.001 by default), the --stat-hist counts, engine and seed")
+		("merge", po::value<std::vector<std::string> >(&args.merge)->multitoken(),
+			"draw nothing and print the --stat-* report of these --emit-summary "
+			"files combined; moments, min, max and histograms combine exactly, "
+			"the median and quantiles through the sketches")
+		("analyze", po::value<std::string>(&args.input)->implicit_value("-"),
+			"draw nothing and print the --stat-* report of the numbers in this "
+			"file, or stdin if none or -: text, or raw if --format is raw or the "
+			"input starts with a --header. Files are parsed on --threads threads; "
+			"--stat-hist bins it over [lbound, ubound] and counts what falls outside")
+		("stat-window", po::value<long long>(&args.stat_window)->default_value(0),
+			"print the avg, variance, min and max of the last this many numbers "
+			"on stderr every --stat-every numbers, as the run goes")
+		("stat-every", po::value<long long>(&args.stat_every)->default_value(0),
+			"numbers between --stat-window records; 0 for the window size");
+
+	po::options_description all("Allowed options");
+	all.add(general).add(intern).add(rounding).add(matcher).add(stats);
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, all), vm);
+	po::notify(vm);
+
+	if(vm.count("help")) {
+		std::cout << all << '\n';
+		return returnID::success_help;
+	}
+
+	if(args.precision > ld_prec) {
+		std::cerr << "error: --precision cannot be greater than the precision"
+			" for <long double> (" << ld_prec << ")\n";
+		return returnID::overd_err;
+	}
+
+	if(args.precision <= -1) {
+		std::cerr << "error: --precision cannot be < 0\n";
+		return returnID::underd_err;
+	}
+
+	if(vm.count("bytes")) {
+		const auto & bytes = vm["bytes"].as<std::string>();
+		try {
+			args.bytes = bytes == "inf" ? -1 : std::stoll(bytes);
+		} catch(const std::exception &) {
+			args.bytes = 0;
+		}
+		if(args.bytes == 0 || args.bytes < -1) {
+			std::cerr << "error: the argument for option '--bytes' is invalid"
+				" (must be >= 1 or inf)\n";
+			return returnID::zero_err;
+		}
+	}
+
+	for(const auto & list : args.stat_quantile) {
+		std::stringstream items(list);
+		std::string item;
+		while(std::getline(items, item, ',')) {
+			if(item.empty()) continue;
+			long double q;
+			try {
+				q = std::stold(item);
+			} catch(const std::exception &) {
+				q = std::numeric_limits<long double>::quiet_NaN();
+			}
+			if(!(q >= 0 && q <= 1)) {
+				std::cerr << "error: --stat-quantile values must be between 0 and 1\n";
+				return returnID::overd_err;
+			}
+			args.quantiles.push_back(q);
+		}
+	}
+
+	// Below 1e-6 the sketch would no longer be small; 0 keeps every number.
+	if(!(args.sketch_error == 0 || (args.sketch_error >= 1e-6L && args.sketch_error < 1))) {
+		std::cerr << "error: --sketch-error must be 0, or >= 1e-6 and < 1\n";
+		return returnID::overd_err;
+	}
+
+	if(args.stat_hist < 0 || args.stat_hist > 1 << 24) {
+		std::cerr << "error: the argument for option '--stat-hist' is invalid"
+			" (must be between 0 and 16777216)\n";
+		return returnID::overd_err;
+	}
+
+	// --mmap threads write their slices straight to the file, and none of
+	// the stats see the numbers.
+	const bool stating = args.stat_all || args.stat_min || args.stat_max || args.stat_median
+		|| args.stat_avg || args.stat_var || args.stat_std || args.stat_coef || args.stat_skew
+		|| args.stat_kurt || args.stat_mode || args.stat_topk || !args.stat_quantile.empty()
+		|| args.stat_hist || args.stat_window || !args.emit_summary.empty();
+	if(stating && args.mmap) {
+		std::cerr << "error: --stat-* and --emit-summary cannot be used with --mmap, which keeps no stats\n";
+		return returnID::conflict_err;
+	}
+	if(!args.merge.empty() && (args.mmap || args.bytes != 0)) {
+		std::cerr << "error: --merge cannot be used with --mmap or --bytes\n";
+		return returnID::conflict_err;
+	}
+	if(!args.input.empty() && (!args.merge.empty() || args.mmap || args.bytes != 0)) {
+		std::cerr << "error: --analyze cannot be used with --merge, --mmap or --bytes\n";
+		return returnID::conflict_err;
+	}
+	if(args.stat_topk < 0) {
+		std::cerr << "error: the argument for option '--stat-topk' is invalid"
+			" (must be >= 0)\n";
+		return returnID::underd_err;
+	}
+	if((args.stat_mode || args.stat_topk) && !args.merge.empty()) {
+		std::cerr << "error: --stat-mode and --stat-topk are not kept in summaries for --merge\n";
+		return returnID::conflict_err;
+	}
+	if(args.stat_window < 0 || args.stat_every < 0) {
+		std::cerr << "error: --stat-window and --stat-every must be >= 0\n";
+		return returnID::underd_err;
+	}
+	if(args.stat_every != 0 && args.stat_window == 0) {
+		std::cerr << "error: --stat-every needs --stat-window\n";
+		return returnID::conflict_err;
+	}
+	if(args.stat_window != 0 && (!args.merge.empty() || !args.input.empty())) {
+		std::cerr << "error: --stat-window cannot be used with --merge or --analyze\n";
+		return returnID::conflict_err;
+	}
+	// A merge or an analysis draws nothing.
+	if(!args.merge.empty() || !args.input.empty()) args.quiet = true;
+
+	if(args.batch_size <= 0) {
+		std::cerr << "error: the argument for option '--batch-size' is invalid"
+			" (must be >= 1)\n";
+		return returnID::zero_err;
+	}
+
+	if(args.number_text == "inf") {
+		args.endless = true;
+		args.number = std::numeric_limits<long long>::max();
+	} else {
+		std::size_t used = 0;
+		try {
+			args.number = std::stoll(args.number_text, &used);
+		} catch(const std::exception &) {
+			used = 0;
+		}
+		if(used == 0 || used != args.number_text.size()) {
+			std::cerr << "error: the argument ('" << args.number_text << "') for option '--number' is invalid\n";
+			return returnID::known_err;
+		}
+	}
+	if(args.number <= 0) {
+		std::cerr << "error: the argument for option '--number' is invalid"
+			" (must be >= 1)\n";
+		return returnID::zero_err;
+	}
+	// Nothing grows with the count of an endless run: quantiles are
+	// sketched, and modes and --norepeat need a bounded set of values,
+	// checked once that is known.
+	if(args.endless && args.sketch_error == 0
+			&& (args.stat_all || args.stat_median || !args.quantiles.empty()))
+		args.sketch_error = 0.001;
+	if(args.endless && args.mmap) {
+		std::cerr << "error: --mmap needs a finite --number\n";
+		return returnID::conflict_err;
+	}
+
+	const std::vector<std::string> gen_opts {{"minstd_rand0", "minstd_rand",
+		"mt19937", "mt19937_64", "ranlux24_base", "ranlux48_base", "ranlux24",
+		"ranlux48", "knuth_b", "default_random_engine", "badrandom"}};
+	if(std::find(gen_opts.begin(), gen_opts.end(), args.generator) == gen_opts.end()) {
+		std::cerr << "error: --generator must be: minstd_rand0, minstd_rand, "
+			"mt19937, mt19937_64, ranlux24_base, ranlux48_base, "
+			"ranlux24, ranlux48, knuth_b, default_random_engine, badrandom\n";
+		return returnID::gen_err;
+	}
+
+	if(args.ceil + args.floor + args.round + args.trunc > 1) {
+		std::cerr << "error: --ceil, --floor, --round, and --trunc"
+			" are mutually exclusive\n";
+		return returnID::conflict_err;
+	}
+
+	if(args.ceil || args.floor || args.round || args.trunc) {
+		args.precision = 0;
+	}
+
+	if(!vm.count("seed")) args.seed = static_cast<unsigned long long>(std::random_device{}()) << 32 | std::random_device{}();
+
+	const std::map<std::string, output_format> formats {{{"text", output_format::text},
+		{"csv", output_format::csv}, {"ndjson", output_format::ndjson}, {"json", output_format::json},
+		{"raw-f32", output_format::raw_f32}, {"raw-f64", output_format::raw_f64},
+		{"raw-f80", output_format::raw_f80}, {"raw-i64", output_format::raw_i64}}};
+	const auto format = formats.find(args.format_name);
+	if(format == formats.end()) {
+		std::cerr << "error: --format must be: text, csv, ndjson, json, raw-f32, raw-f64, raw-f80, raw-i64\n";
+		return returnID::conflict_err;
+	}
+	args.format = format->second;
+	if(args.format == output_format::raw_f80 && std::numeric_limits<long double>::digits != 64) {
+		std::cerr << "error: --format raw-f80 needs an 80-bit long double\n";
+		return returnID::conflict_err;
+	}
+	if(args.format == output_format::raw_i64 && !(args.ceil || args.floor || args.round || args.trunc || args.decimal)) {
+		std::cerr << "error: --format raw-i64 needs --ceil, --floor, --round, --trunc or --decimal\n";
+		return returnID::conflict_err;
+	}
+	// --decimal checks its own range once the unit is known.
+	if(args.format == output_format::raw_i64 && !args.decimal
+			&& (std::fabs(args.lbound) >= 9.2e18L || std::fabs(args.ubound) >= 9.2e18L)) {
+		std::cerr << "error: --format raw-i64 needs |--lbound| and |--ubound| below 9.2e18\n";
+		return returnID::overd_err;
+	}
+	if(args.header && !binary(args.format)) {
+		std::cerr << "error: --header only applies to raw formats\n";
+		return returnID::conflict_err;
+	}
+	if(args.splice && !binary(args.format) && args.bytes == 0) {
+		std::cerr << "error: --splice only applies to raw formats and --bytes\n";
+		return returnID::conflict_err;
+	}
+	if(args.direct && (args.output.empty() || (!binary(args.format) && args.bytes == 0))) {
+		std::cerr << "error: --direct needs --output and a raw format or --bytes\n";
+		return returnID::conflict_err;
+	}
+	if(args.mmap && (args.output.empty() || !binary(args.format)
+			|| args.direct || args.splice || args.bytes != 0)) {
+		std::cerr << "error: --mmap needs --output and a raw format, and cannot be"
+			" used with --direct, --splice or --bytes\n";
+		return returnID::conflict_err;
+	}
+	if(args.threads < 0) {
+		std::cerr << "error: the argument for option '--threads' is invalid"
+			" (must be >= 0)\n";
+		return returnID::underd_err;
+	}
+	const bool exact_ranks = (args.stat_all || args.stat_median || !args.quantiles.empty())
+		&& args.sketch_error == 0;
+	if(args.threads != 1 && !args.mmap && !exact_ranks && args.input.empty()) {
+		std::cerr << "error: --threads only applies to --mmap, --analyze and exact medians and quantiles\n";
+		return returnID::conflict_err;
+	}
+	if(args.threads != 1 && args.mmap && args.generator == "badrandom") {
+		std::cerr << "error: --threads needs a standard engine, std::rand has one shared state\n";
+		return returnID::conflict_err;
+	}
+	if(binary(args.format) && args.list) {
+		std::cerr << "error: --list does not apply to binary formats\n";
+		return returnID::conflict_err;
+	}
+	if(args.format != output_format::text && vm.count("delim")) {
+		std::cerr << "error: --delim only applies to --format text\n";
+		return returnID::conflict_err;
+	}
+
+	args.excluded_units = args.excluded;
+	args.included_units = args.included;
+	if(args.decimal) {
+		static constexpr long double max_unit = 9.2e18L;
+		args.unit = std::pow(10.0L, args.precision);
+		if(std::fabs(args.lbound) * args.unit >= max_unit || std::fabs(args.ubound) * args.unit >= max_unit) {
+			std::cerr << "error: --decimal needs |--lbound| and |--ubound| below 9.2e18 / 10^precision\n";
+			return returnID::overd_err;
+		}
+		args.decimal_min = std::ceil(args.lbound * args.unit);
+		args.decimal_max = std::floor(args.ubound * args.unit);
+
+		// Values off the grid can never be generated and compare as NaN.
+		auto to_units = [&](long double & v) {
+			const long double k = std::round(v * args.unit);
+			const bool on_grid = std::fabs(v * args.unit - k)
+				<= 64 * std::numeric_limits<long double>::epsilon() * std::max(1.0L, std::fabs(k));
+			v = on_grid ? k : std::numeric_limits<long double>::quiet_NaN();
+		};
+		std::for_each(args.excluded_units.begin(), args.excluded_units.end(), to_units);
+		std::for_each(args.included_units.begin(), args.included_units.end(), to_units);
+	}
+	
+	std::vector<std::vector<std::string> > filters = {{args.prefix, args.suffix, args.contains}};
+	for(auto i : filters) {
+		for(auto j : i) {
+			if(j.find_first_not_of("0123456789.") != std::string::npos || std::count(std::begin(j), std::end(j), '.') > 1) {
+				std::cerr << "error: --prefix, --suffix, and --contains can only be numbers\n";
+				return returnID::vect_nan;
+			}
+		}
+	}
+
+	for(const auto & i : args.prefix) args.patterns.add(i, pattern_automaton::prefix);
+	for(const auto & i : args.suffix) args.patterns.add(i, pattern_automaton::suffix);
+	for(const auto & i : args.contains) args.patterns.add(i, pattern_automaton::contains);
+	args.patterns.compile();
+
+	const long double cell_offset = args.ceil ? -1 : args.floor || args.trunc ? 0 : -0.5;
+	args.sampler.build(args.prefix, args.suffix, args.precision, args.lbound, args.ubound,
+		cell_offset, args.decimal);
+
+	if(!args.match.empty()) {
+		const auto what = args.matcher.compile(args.match);
+		if(!what.empty()) {
+			std::cerr << "error: --match " << what << '\n';
+			return returnID::match_err;
+		}
+	}
+
+	if(args.ubound < args.lbound) {
+		std::cerr << "error: --lbound cannot be greater than --ubound\n";
+		return returnID::infeasible_err;
+	}
+
+	// --merge and --analyze draw nothing, so there is nothing to refuse.
+	const auto result = args.merge.empty() && args.input.empty() ? check_feasibility(args) : returnID::success;
+	if(result != returnID::success) return result;
+	// --mmap places number i at a fixed offset, so none can be dropped.
+	if(args.mmap && !(args.acceptance_exact && args.acceptance == 1 && !args.norepeat)) {
+		std::cerr << "error: --mmap needs every draw kept: no matcher that can"
+			" reject a number and no --norepeat\n";
+		return returnID::conflict_err;
+	}
+	if(args.endless && args.stat_mode) {
+		const auto [lo, hi] = count_range(args);
+		if(!((args.decimal || args.ceil || args.floor || args.round || args.trunc)
+				&& hi - lo <= histogram::max_exact)) {
+			std::cerr << "error: --stat-mode with --number inf needs rounded or decimal numbers"
+				" over at most " << histogram::max_exact << " values\n";
+			return returnID::conflict_err;
+		}
+	}
+	if(args.endless && args.norepeat && args.capacity <= 0) {
+		std::cerr << "error: --norepeat with --number inf needs a bounded set of numbers"
+			" that can pass the filters\n";
+		return returnID::conflict_err;
+	}
+	return returnID::success;
+}
+
+// std::rand behind the UniformRandomBitGenerator interface, so "badrandom" can
+// drive the same distributions as the standard engines.
+struct bad_random {
+	using result_type = unsigned;
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return RAND_MAX; }
+	explicit bad_random(const unsigned long long seed) { std::srand(seed); }
+	result_type operator()() { return std::rand(); }
+};
+
+// Stream 0 is the run's engine; other streams seed independent engines from
+// the same seed, one per --mmap thread.
+template<typename GEN = std::mt19937, typename F>
+void r_gen(const unsigned long long seed, F && f, const unsigned stream = 0) {
+	std::vector<unsigned> words{static_cast<unsigned>(seed), static_cast<unsigned>(seed >> 32)};
+	if(stream) words.push_back(stream);
+	std::seed_seq seq(words.begin(), words.end());
+	GEN generator{seq};
+	f(generator);
+}
+
+// Calls f once with the engine selected by --generator, seeded for the run.
+template<typename F>
+void with_generator(const program_args & args, F && f, const unsigned stream = 0) {
+	if(args.generator == "minstd_rand0") r_gen<std::minstd_rand0>(args.seed, f, stream);
+	else if(args.generator == "minstd_rand") r_gen<std::minstd_rand>(args.seed, f, stream);
+	else if(args.generator == "mt19937_64") r_gen<std::mt19937_64>(args.seed, f, stream);
+	else if(args.generator == "ranlux24_base") r_gen<std::ranlux24_base>(args.seed, f, stream);
+	else if(args.generator == "ranlux48_base") r_gen<std::ranlux48_base>(args.seed, f, stream);
+	else if(args.generator == "ranlux24") r_gen<std::ranlux24>(args.seed, f, stream);
+	else if(args.generator == "ranlux48") r_gen<std::ranlux48>(args.seed, f, stream);
+	else if(args.generator == "knuth_b") r_gen<std::knuth_b>(args.seed, f, stream);
+	else if(args.generator == "default_random_engine") r_gen<std::default_random_engine>(args.seed, f, stream);
+	else if(args.generator == "badrandom") {
+		bad_random generator{args.seed};
+		f(generator);
+	}
+	else r_gen<std::mt19937>(args.seed, f, stream);
+}
+
+template<typename GEN>
+long double random(const program_args & args, GEN & generator) {
+	if(args.sampler.active()) return args.sampler(generator);
+	if(args.decimal) return std::uniform_int_distribution<long long>{args.decimal_min, args.decimal_max}(generator);
+	return std::uniform_real_distribution<long double>{args.lbound, args.ubound}(generator);
+}
+
+long double random(const program_args & args, bad_random & generator) {
+	if(args.sampler.active()) return args.sampler(generator);
+	if(args.decimal) return std::uniform_int_distribution<long long>{args.decimal_min, args.decimal_max}(generator);
+	return args.lbound + (generator() / (RAND_MAX / (args.ubound - args.lbound)));
+}
+
+bool filter(const long double rand, const program_args & args) {
+	char buf[64];
+	std::string fallback;
+	std::string_view str_rand;
+	if(args.decimal) {
+		str_rand = std::string_view(buf, fixed_format::scaled(buf, rand, args.precision) - buf);
+	} else if(const char * last = fixed_format::format(buf, rand, args.precision)) {
+		str_rand = std::string_view(buf, last - buf);
+	} else {
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(args.precision) << rand;
+		str_rand = fallback = oss.str();
+	}
+	return (!args.patterns.empty() && !args.patterns.accept(str_rand))
+		|| (!args.matcher.empty() && !args.matcher.accept(str_rand));
+}
+
+long double rounded(const program_args & args, const long double rand) {
+	if(args.ceil) return std::ceil(rand);
+	else if(args.floor) return std::floor(rand);
+	else if(args.round) return std::round(rand);
+	else if(args.trunc) return std::trunc(rand);
+	return rand;
+}
+
+// The [lo, hi) that --stat-hist and --stat-mode count over, in units like
+// every stat; integer-valued numbers take one unit each.
+std::pair<long double, long double> count_range(const program_args & args) {
+	const bool rounding = args.ceil || args.floor || args.round || args.trunc;
+	if(args.decimal) return {args.decimal_min, args.decimal_max + 1};
+	if(rounding) return {rounded(args, args.lbound), rounded(args, args.ubound) + 1};
+	return {args.lbound, args.ubound};
+}
+
+// Every matcher except --norepeat, which depends on what was generated before.
+bool rejected(const program_args & args, const long double rand) {
+	if(!args.excluded_units.empty()) {
+		const profiler::scope timed{profile, profiler::exclude};
+		if(std::find(args.excluded_units.begin(), args.excluded_units.end(), rand) != args.excluded_units.end())
+			return true;
+	}
+	if(!args.included_units.empty()) {
+		const profiler::scope timed{profile, profiler::include};
+		if(std::find(args.included_units.begin(), args.included_units.end(), rand) == args.included_units.end())
+			return true;
+	}
+	if(!args.patterns.empty() || !args.matcher.empty()) {
+		const profiler::scope timed{profile, profiler::digits};
+		return filter(rand, args);
+	}
+	return false;
+}
+
+// Probability that a uniform draw from the bounds rounds to exactly v, given
+// in the units numbers are generated in.
+long double hit_probability(const program_args & args, const long double v) {
+	if(args.decimal) {
+		const bool hit = v >= args.decimal_min && v <= args.decimal_max;
+		return hit ? 1 / (static_cast<long double>(args.decimal_max) - args.decimal_min + 1) : 0;
+	}
+
+	const long double width = args.ubound - args.lbound;
+	if(width == 0) return rounded(args, args.lbound) == v;
+
+	const bool rounding = args.ceil || args.floor || args.round || args.trunc;
+	if(!rounding || v != std::trunc(v)) return 0;
+
+	long double lo, hi;
+	if(args.round) lo = v - 0.5, hi = v + 0.5;
+	else if(args.floor || (args.trunc && v > 0)) lo = v, hi = v + 1;
+	else if(args.ceil || v < 0) lo = v - 1, hi = v;
+	else lo = -1, hi = 1;
+
+	return std::max(0.0L, std::min(hi, args.ubound) - std::max(lo, args.lbound)) / width;
+}
+
+long double harmonic(const long double n) {
+	static constexpr long double euler = 0.577215664901532860606512090082402431L;
+	if(n < 64) {
+		long double h = 0;
+		for(long long i = 1; i <= n; ++i) h += 1.0L / i;
+		return h;
+	}
+	return std::log(n) + euler + 1 / (2 * n) - 1 / (12 * n * n);
+}
+
+// Works out how likely a draw is to survive the rounding and matcher options,
+// exactly where the options allow it and by simulation when digit filters are
+// involved, so that configurations that can never finish are refused up front.
+returnID check_feasibility(program_args & args) {
+	static constexpr long long trials = 1 << 14;
+
+	const bool rounding = args.ceil || args.floor || args.round || args.trunc;
+	const bool digits = !args.patterns.empty() || !args.matcher.empty();
+
+	std::vector<long double> included(args.included_units), excluded(args.excluded_units);
+	std::sort(included.begin(), included.end());
+	included.erase(std::unique(included.begin(), included.end()), included.end());
+	std::sort(excluded.begin(), excluded.end());
+	excluded.erase(std::unique(excluded.begin(), excluded.end()), excluded.end());
+	auto is_excluded = [&](const long double v) {
+		return std::binary_search(excluded.begin(), excluded.end(), v);
+	};
+
+	long double & capacity = args.capacity;
+
+	if(args.sampler.impossible() || (args.decimal && args.decimal_max < args.decimal_min)) {
+		args.acceptance = 0;
+	} else if(digits) {
+		std::mt19937 generator{0};
+		long long hits = 0;
+		for(long long i = 0; i < trials; ++i)
+			hits += !rejected(args, rounded(args, random(args, generator)));
+		args.acceptance = static_cast<long double>(hits) / trials;
+		args.acceptance_exact = false;
+	} else if(!included.empty()) {
+		args.acceptance = 0;
+		for(const auto v : included) {
+			const auto p = is_excluded(v) ? 0 : hit_probability(args, v);
+			args.acceptance += p;
+			capacity += p > 0;
+		}
+	} else {
+		args.acceptance = 1;
+		for(const auto v : excluded) args.acceptance -= hit_probability(args, v);
+		if(args.lbound == args.ubound) {
+			capacity = 1;
+		} else if(rounding || args.decimal) {
+			const long double first = args.decimal ? args.decimal_min : rounded(args, args.lbound);
+			const long double last = args.decimal ? args.decimal_max : rounded(args, args.ubound);
+			capacity = std::max(0.0L, last - first + 1);
+			if(capacity > 0 && hit_probability(args, first) <= 0) --capacity;
+			if(capacity > 0 && last != first && hit_probability(args, last) <= 0) --capacity;
+			for(const auto v : excluded)
+				capacity -= v >= first && v <= last && hit_probability(args, v) > 0;
+		}
+	}
+
+	if(args.acceptance <= 0 && args.acceptance_exact) {
+		std::cerr << "error: no number in [" << args.lbound << ", " << args.ubound
+			<< "] can pass the rounding and matcher options\n";
+		return returnID::infeasible_err;
+	}
+
+	if(args.norepeat && args.numbers_force && capacity > 0 && args.number > capacity) {
+		std::cerr << "error: --norepeat with --numbers-force needs " << args.number
+			<< " distinct numbers but only " << capacity << " can pass the filters\n";
+		return returnID::infeasible_err;
+	}
+
+	if(args.acceptance <= 0) {
+		std::cerr << "warning: none of " << trials << " trial draws passed the filters";
+		if(args.numbers_force) std::cerr << ", --numbers-force may never finish";
+		std::cerr << '\n';
+		args.expected_draws = std::numeric_limits<long double>::infinity();
+		return returnID::success;
+	}
+
+	// Under --norepeat every accepted value shrinks the pool, as in the coupon
+	// collector problem; treat the remaining values as equally likely.
+	args.expected_draws = 1 / args.acceptance;
+	if(args.norepeat && args.numbers_force && capacity > 0)
+		args.expected_draws *= capacity * (harmonic(capacity) - harmonic(capacity - args.number)) / args.number;
+
+	if(args.expected_draws > 100) {
+		std::cerr << "warning: about " << std::setprecision(3) << 100 / args.expected_draws
+			<< "% of draws pass the filters (" << args.expected_draws << " draws per number)\n";
+	}
+
+	return returnID::success;
+}
+
+// --bench-format: times fixed_format against the std::ostream path it
+// replaces over the same values, checking the two agree on every one.
+template<typename T>
+void bench_format(const char * name, const long long n, const int precision) {
+	std::mt19937_64 generator{42};
+	std::uniform_real_distribution<T> dis{-1e6, 1e6};
+	std::vector<T> values(n);
+	for(long long i = 0; i < n; ++i) {
+		values[i] = dis(generator);
+		if(i % 4 == 1) values[i] = std::round(values[i]);
+		if(i % 4 == 2) values[i] = std::ldexp(values[i], -static_cast<int>(generator() % 80));
+	}
+
+	using clock = std::chrono::steady_clock;
+	std::size_t checksum = 0;
+
+	std::ostringstream oss;
+	oss << std::fixed << std::setprecision(precision);
+	const auto stream_start = clock::now();
+	for(const auto v : values) {
+		oss.str("");
+		oss << v;
+		checksum += oss.str().size();
+	}
+	const auto stream_time = clock::now() - stream_start;
+
+	char buf[64];
+	const auto fast_start = clock::now();
+	for(const auto v : values) checksum += fixed_format::format(buf, v, precision) - buf;
+	const auto fast_time = clock::now() - fast_start;
+
+	long long mismatches = 0;
+	for(const auto v : values) {
+		oss.str("");
+		oss << v;
+		mismatches += std::string_view(buf, fixed_format::format(buf, v, precision) - buf) != oss.str();
+	}
+
+	const auto per_value = [n](const clock::duration d) {
+		return std::chrono::duration<double, std::nano>(d).count() / n;
+	};
+	std::cout << std::defaultfloat << std::setprecision(4) << name << " (precision " << precision
+		<< "): ostream " << per_value(stream_time) << " ns, fixed_format " << per_value(fast_time)
+		<< " ns, speedup " << per_value(stream_time) / per_value(fast_time)
+		<< "x, mismatches " << mismatches << " (checksum " << checksum << ")\n";
+}
+
+// Packs the output of any engine into uniform 64-bit words for --bytes.
+// Engines whose range is a whole number of bits contribute all of them;
+// others contribute their largest whole bit count per call and reject the
+// uneven top of their range.
+template<typename GEN>
+class word_source {
+public:
+	explicit word_source(GEN & g) : generator(g) {}
+
+	void fill(unsigned long long * words, const std::size_t n) {
+		if(bits == 64) {
+			for(std::size_t i = 0; i < n; ++i) words[i] = generator();
+		} else if(bits == 32 && whole) {
+			for(std::size_t i = 0; i < n; ++i) {
+				const unsigned long long lo = generator() - GEN::min();
+				words[i] = lo | static_cast<unsigned long long>(generator() - GEN::min()) << 32;
+			}
+		} else {
+			for(std::size_t i = 0; i < n; ++i) words[i] = next();
+		}
+	}
+
+private:
+	using u64 = unsigned long long;
+
+	static constexpr u64 range = static_cast<u64>(GEN::max() - GEN::min());
+
+	static constexpr int floor_log2(const u64 v) {
+		int b = 0;
+		while(v >> (b + 1)) ++b;
+		return b;
+	}
+
+	static constexpr int bits = range == ~0ull ? 64 : floor_log2(range + 1);
+	static constexpr bool whole = bits == 64 || range == (1ull << bits) - 1;
+	static constexpr u64 mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+	// Values from 2^bits up are rejected when the range is not whole.
+	static constexpr u64 limit = whole ? ~0ull : 1ull << bits;
+
+	GEN & generator;
+	u64 pending = 0;
+	int held = 0;
+
+	u64 next() {
+		u64 word = 0;
+		int filled = 0;
+		while(filled < 64) {
+			if(held == 0) {
+				u64 v;
+				do v = static_cast<u64>(generator() - GEN::min()); while(v >= limit);
+				pending = v & mask;
+				held = bits;
+			}
+			const int take = std::min(held, 64 - filled);
+			word |= (pending & (take == 64 ? ~0ull : (1ull << take) - 1)) << filled;
+			pending = take == 64 ? 0 : pending >> take;
+			held -= take;
+			filled += take;
+		}
+		return word;
+	}
 };
 
-returnID parse_args(program_args & args, int argc, char const * const * argv) {
-	static auto const ld_prec = std::numeric_limits<long double>::max_digits10;
+// --bytes: streams engine words to stdout from the writer's buffer, forever
+// when count is negative.
+template<typename GEN>
+void write_bytes(output_writer & out, GEN & generator, long long count) {
+	const std::size_t chunk = out.size();
+	word_source<GEN> words{generator};
+	std::vector<unsigned long long> tail(1);
 
-	namespace po = boost::program_options;
-	po::options_description general("General options");
-	general.add_options()
-		("help,h", "produce this help message")
-		("precision,p", po::value<int>(&args.precision)->default_value(ld_prec), 
-			"output precision (not internal precision)")
-		("quiet,q", po::bool_switch(&args.quiet)->default_value(false),
-			"disable number output, useful with stats")
-		("list", po::bool_switch(&args.list)->default_value(false),
-			"print numbers in a list")
-		("delim", po::value<std::string>(&args.delim),
-			"change the delimiter")
-		("numbers-force", po::bool_switch(&args.numbers_force)->default_value(false),
-			"force the count of numbers printed to be equal to --number")
-		("flags", po::bool_switch(&args.flags)->default_value(false),
-			"print the flags");
+	while(count != 0 && !interrupted && !out.broken()) {
+		const std::size_t n = count < 0 ? chunk : std::min<long long>(count, chunk);
+		{
+			const profiler::scope timed{profile, profiler::generate};
+			const tracer::span span(trace, "generate", n);
+			char * first = out.reserve(chunk);
+			words.fill(reinterpret_cast<unsigned long long *>(first), n / 8);
+			if(n % 8) {
+				words.fill(tail.data(), 1);
+				std::memcpy(first + n / 8 * 8, tail.data(), n % 8);
+			}
+			out.commit(n);
+		}
+		{
+			const profiler::scope timed{profile, profiler::write};
+			const tracer::span span(trace, "write", n);
+			out.flush();
+		}
+		profile.bytes += n;
+		if(count > 0) count -= n;
+	}
+}
 
-	po::options_description intern("Internal RNG options");
-	intern.add_options()
-		("number,n", po::value<long long>(&args.number)->default_value(1),
-			"count of numbers to be generated")
-		("lbound,l", po::value<long double>(&args.lbound)->default_value(0.0),
-			"minimum number (ldouble)")
-		("ubound,u", po::value<long double>(&args.ubound)->default_value(1.0),
-			"maximum number (ldouble)")
-		("generator,g", po::value<std::string>(&args.generator)->default_value("mt19937"),
-			"change the RNG algorithm:\nminstd_rand0, minstd_rand"
-			"\nmt19937, mt19937_64\nranlux24_base, ranlux48_base"
-			"\nranlux24, ranlux48\nknuth_b, default_random_engine"
-			"\nbadrandom (std::rand)");
+// Whether exactly --number numbers come out.
+bool counted(const program_args & args) {
+	if(args.endless) return false;
+	return args.numbers_force || (args.acceptance_exact && args.acceptance == 1 && !args.norepeat);
+}
 
-	po::options_description rounding("Rounding options");
-	rounding.add_options()
-		("ceil,c", po::bool_switch(&args.ceil)->default_value(false),
-			"apply ceiling function")
-		("floor,f", po::bool_switch(&args.floor)->default_value(false),
-			"apply floor function")
-		("round,r", po::bool_switch(&args.round)->default_value(false),
-			"apply round function")
-		("trunc,t", po::bool_switch(&args.trunc)->default_value(false),
-			"apply truncation");
+// Size of the output when it is known up front, or -1.
+long long output_size(const program_args & args) {
+	if(args.bytes != 0) return args.bytes;
+	if(args.quiet) return 0;
+	if(!binary(args.format) || !counted(args)) return -1;
+	return (args.header ? 24 : 0) + args.number * format_sizes[static_cast<int>(args.format)];
+}
 
-	po::options_description matcher("Matcher options");
-	matcher.add_options()
-		("exclude", po::value<std::vector<long double> >(&args.excluded)->multitoken(), 
-			"print only the numbers not exactly specified, best with rounding")
-		("include", po::value<std::vector<long double> >(&args.included)->multitoken(),
-			"print only the numbers exactly specified, best with rounding ")
-		("norepeat", po::bool_switch(&args.norepeat)->default_value(false),
-			"exclude repeated numbers from being printed, best with rounding")
-		("prefix", po::value<std::vector<std::string> >(&args.prefix)->multitoken(),
-			"only print if the number begins with string(s)")
-		("suffix", po::value<std::vector<std::string> >(&args.suffix)->multitoken(),
-			"only print if the number ends with string(s)")
-		("contains", po::value<std::vector<std::string> >(&args.contains)->multitoken(),
-			"only print if the number contains string(s)");
+void write_header(output_writer & out, const program_args & args) {
+	const auto type = static_cast<unsigned char>(args.format);
+	out.put("DRAW", 4);
+	out.put(static_cast<char>(1));
+	out.put(static_cast<char>(type));
+	out.put(static_cast<char>(format_sizes[type]));
+	out.put(static_cast<char>(0));
+	out.little_endian(counted(args) ? static_cast<unsigned long long>(args.number) : ~0ull);
+	out.little_endian(args.seed);
+}
 
-	po::options_description stats("Statistics options");
-	stats.add_options()
-		("stat-all", po::bool_switch(&args.stat_all)->default_value(false),
-			"print all statistics")
-		("stat-min", po::bool_switch(&args.stat_min)->default_value(false), 
-			"print the minimum")
-		("stat-max", po::bool_switch(&args.stat_max)->default_value(false),
-			"print the maximum")
-		("stat-median", po::bool_switch(&args.stat_median)->default_value(false),
-			"print the median")
-		("stat-avg", po::bool_switch(&args.stat_avg)->default_value(false),
-			"print the average")
-		("stat-var", po::bool_switch(&args.stat_var)->default_value(false),
-			"print the variance")
-		("stat-std", po::bool_switch(&args.stat_std)->default_value(false),
-			"print the standard deviation")
-		("stat-coef", po::bool_switch(&args.stat_coef)->default_value(false),
-			"print the coefficient of variation");
+// kept holds each number with its draw index; accepted numbers before the
+// batch are counted in done, for --list with --numbers-force.
+void write_text(output_writer & out, const program_args & args,
+		const std::vector<std::pair<long double, long long> > & kept, long long done,
+		const number_table * table) {
+	for(const auto & k : kept) {
+		if(args.list && args.numbers_force) {
+			out.integer(++done);
+			out.put(". ", 2);
+		}
+		if(args.list) {
+			out.integer(k.second);
+			out.put(". ", 2);
+		}
+		if(table) {
+			const auto text = (*table)[k.first];
+			if(!text.empty()) {
+				out.put(text.data(), text.size());
+				continue;
+			}
+		}
+		if(args.decimal) out.decimal(k.first, args.precision);
+		else out.fixed(k.first, args.precision);
+		out.put(args.delim);
+	}
+}
 
-	po::options_description all("Allowed options");
-	all.add(general).add(intern).add(rounding).add(matcher).add(stats);
+// --format csv, ndjson and json: the numbers of write_text with the --list
+// indices as fields, "n" for the accepted count and "index" for the draw.
+// done counts the numbers already written; the table holds bare numbers.
+void write_structured(output_writer & out, const program_args & args,
+		const std::vector<std::pair<long double, long long> > & kept, long long done,
+		const number_table * table) {
+	const bool csv = args.format == output_format::csv;
+	const bool json = args.format == output_format::json;
+	const bool object = !csv && (args.list || !json);
+	const std::string_view sep = csv ? "," : ", ";
 
-	po::variables_map vm;
-	po::store(po::parse_command_line(argc, argv, all), vm);
-	po::notify(vm);
+	for(const auto & k : kept) {
+		if(json && done) out.put(",\n", 2);
+		++done;
+		if(object) out.put('{');
+		if(args.list && args.numbers_force) {
+			if(!csv) out.put("\"n\": ", 5);
+			out.integer(done);
+			out.put(sep);
+		}
+		if(args.list) {
+			if(!csv) out.put("\"index\": ", 9);
+			out.integer(k.second);
+			out.put(sep);
+		}
+		if(object) out.put("\"value\": ", 9);
+		const auto text = table ? (*table)[k.first] : std::string_view();
+		if(!text.empty()) out.put(text);
+		else if(args.decimal) out.decimal(k.first, args.precision);
+		else out.fixed(k.first, args.precision);
+		if(object) out.put('}');
+		if(!json) out.put('\n');
+	}
+}
 
-	if(vm.count("help")) {
-		std::cout << all << '\n';
-		return returnID::success_help;
+// Opens the CSV column row or the JSON object holding the numbers.
+void begin_structured(output_writer & out, const program_args & args) {
+	if(args.format == output_format::csv && !args.quiet) {
+		if(args.list && args.numbers_force) out.put("n,", 2);
+		if(args.list) out.put("index,", 6);
+		out.put("value\n", 6);
 	}
+	if(args.format == output_format::json) out.put(args.quiet ? "{" : "{\"numbers\": [\n");
+}
 
-	if(args.precision > ld_prec) {
-		std::cerr << "error: --precision cannot be greater than the precision"
-			" for <long double> (" << ld_prec << ")\n";
-		return returnID::overd_err;
+// Closes the numbers and adds the trailer members, each starting ", ", as a
+// closing NDJSON line or the rest of the JSON object.
+void end_structured(output_writer & out, const program_args & args, const std::string & trailer) {
+	if(args.format == output_format::ndjson && !trailer.empty()) {
+		out.put('{');
+		out.put(std::string_view(trailer).substr(2));
+		out.put("}\n", 2);
 	}
+	if(args.format == output_format::json) {
+		if(!args.quiet) out.put("\n]", 2);
+		out.put(args.quiet && !trailer.empty() ? std::string_view(trailer).substr(2) : trailer);
+		out.put("}\n", 2);
+	}
+}
 
-	if(args.precision <= -1) {
-		std::cerr << "error: --precision cannot be < 0\n";
-		return returnID::underd_err;
+// Raw formats convert generated units back to values, except raw-i64 which
+// writes the integers as generated.
+void write_raw(output_writer & out, const program_args & args,
+		const std::vector<std::pair<long double, long long> > & kept) {
+	switch(args.format) {
+		case output_format::raw_f32:
+			for(const auto & k : kept) out.little_endian(static_cast<float>(k.first / args.unit));
+			break;
+		case output_format::raw_f64:
+			for(const auto & k : kept) out.little_endian(static_cast<double>(k.first / args.unit));
+			break;
+		case output_format::raw_f80:
+			for(const auto & k : kept) out.little_endian(k.first / args.unit, 10);
+			break;
+		case output_format::raw_i64:
+			for(const auto & k : kept) out.little_endian(static_cast<long long>(k.first));
+			break;
+		default:
+			break;
 	}
+}
 
-	if(args.number <= 0) {
-		std::cerr << "error: the argument for option '--number' is invalid"
-			" (must be >= 1)\n";
-		return returnID::zero_err;
+// One number in a raw format, as write_raw writes it.
+void store_raw(char * first, const program_args & args, const long double v) {
+	switch(args.format) {
+		case output_format::raw_f32: little_endian(first, static_cast<float>(v / args.unit)); break;
+		case output_format::raw_f64: little_endian(first, static_cast<double>(v / args.unit)); break;
+		case output_format::raw_f80: little_endian(first, v / args.unit, 10); break;
+		case output_format::raw_i64: little_endian(first, static_cast<long long>(v)); break;
+		default: break;
 	}
+}
 
-	const std::vector<std::string> gen_opts {{"minstd_rand0", "minstd_rand",
-		"mt19937", "mt19937_64", "ranlux24_base", "ranlux48_base", "ranlux24",
-		"ranlux48", "knuth_b", "default_random_engine", "badrandom"}};
-	if(std::find(gen_opts.begin(), gen_opts.end(), args.generator) == gen_opts.end()) {
-		std::cerr << "error: --generator must be: minstd_rand0, minstd_rand, "
-			"mt19937, mt19937_64, ranlux24_base, ranlux48_base, "
-			"ranlux24, ranlux48, knuth_b, default_random_engine, badrandom\n";
-		return returnID::gen_err;
+// --mmap: sizes the file for every number and maps it, then each thread draws
+// its own slice straight into place with its own engine, so there is nothing
+// to reorder and no writer. Thread 0 has the run's engine, so one thread
+// writes the same file as the streaming path.
+void write_mapped(const int fd, const program_args & args) {
+	const long long size = output_size(args);
+	const long long header = args.header ? 24 : 0;
+	const long long width = format_sizes[static_cast<int>(args.format)];
+	if(ftruncate(fd, size) != 0) throw std::system_error(errno, std::generic_category(), "ftruncate");
+	void * map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap");
+	char * const numbers = static_cast<char *>(map) + header;
+
+	const long long threads = std::min<long long>(args.number,
+		args.threads ? args.threads : std::max(1u, std::thread::hardware_concurrency()));
+	const long long share = args.number / threads, extra = args.number % threads;
+
+	const profiler::scope timed{profile, profiler::generate};
+	std::vector<std::thread> pool;
+	for(long long t = 0; t < threads; ++t) {
+		pool.emplace_back([&, t]() {
+			const long long first = t * share + std::min(t, extra);
+			const long long last = first + share + (t < extra);
+			with_generator(args, [&](auto & generator) {
+				for(long long i = first; i < last; i += args.batch_size) {
+					const long long end = std::min(last, i + args.batch_size);
+					const tracer::span span(trace, "generate", end - i);
+					for(long long j = i; j < end; ++j)
+						store_raw(numbers + j * width, args, rounded(args, random(args, generator)));
+				}
+			}, t);
+		});
 	}
+	for(auto & thread : pool) thread.join();
+	munmap(map, size);
+}
 
-	if(args.ceil + args.floor + args.round + args.trunc > 1) {
-		std::cerr << "error: --ceil, --floor, --round, and --trunc"
-			" are mutually exclusive\n";
-		return returnID::conflict_err;
+// What --emit-summary writes and --merge combines: the engines and seeds
+// drawn with and the stats, in the units drawn in. Files start with "DSUM"
+// and a version byte.
+struct run_summary {
+	struct shard {
+		std::string generator;
+		unsigned long long seed;
+		long long draws, accepted;
+	};
+	std::vector<shard> shards;
+	long double unit = 1;
+	running_stats stats;
+	quantile_sketch sketch;
+	std::optional<histogram> hist;
+
+	std::string save() const {
+		summary_writer to;
+		to.data.append("DSUM", 4);
+		to.put<std::uint8_t>(3);
+		to.put<std::uint32_t>(shards.size());
+		for(const auto & s : shards) {
+			to.put(s.generator);
+			to.put<std::uint64_t>(s.seed);
+			to.put<std::int64_t>(s.draws);
+			to.put<std::int64_t>(s.accepted);
+		}
+		to.put(unit);
+		stats.save(to);
+		sketch.save(to);
+		to.put<std::uint8_t>(hist.has_value());
+		if(hist) hist->save(to);
+		return to.data;
 	}
 
-	if(args.ceil || args.floor || args.round || args.trunc) {
-		args.precision = 0;
+	static run_summary load(std::string data) {
+		if(data.compare(0, 4, "DSUM") != 0) throw std::runtime_error("not a summary");
+		summary_reader from(data.substr(4));
+		if(const int version = from.get<std::uint8_t>(); version != 3)
+			throw std::runtime_error("summary version " + std::to_string(version) + " is not supported");
+		run_summary all;
+		for(auto count = from.get<std::uint32_t>(); count > 0; --count) {
+			shard s;
+			s.generator = from.text();
+			s.seed = from.get<std::uint64_t>();
+			s.draws = from.get<std::int64_t>();
+			s.accepted = from.get<std::int64_t>();
+			all.shards.push_back(s);
+		}
+		all.unit = from.real();
+		all.stats = running_stats::load(from);
+		all.sketch = quantile_sketch::load(from);
+		if(from.get<std::uint8_t>()) all.hist = histogram::load(from);
+		if(!from.done()) throw std::runtime_error("summary has trailing data");
+		return all;
 	}
-	
-	std::vector<std::vector<std::string> > filters = {{args.prefix, args.suffix, args.contains}};
-	for(auto i : filters) {
-		for(auto j : i) {
-			if(j.find_first_not_of("0123456789.") != std::string::npos || std::count(std::begin(j), std::end(j), '.') > 1) {
-				std::cerr << "error: --prefix, --suffix, and --contains can only be numbers\n";
-				return returnID::vect_nan;
+};
+
+// --merge: reads the summaries into all, checking that they can combine.
+returnID merge_summaries(const std::vector<std::string> & paths, run_summary & all) {
+	for(std::size_t i = 0; i < paths.size(); ++i) {
+		std::ifstream in(paths[i], std::ios::binary);
+		if(!in) {
+			std::cerr << "error: cannot open --merge file " << paths[i] << '\n';
+			return returnID::io_err;
+		}
+		run_summary one;
+		try {
+			one = run_summary::load(std::string(std::istreambuf_iterator<char>(in), {}));
+		} catch(const std::runtime_error & e) {
+			std::cerr << "error: " << paths[i] << ": " << e.what() << '\n';
+			return returnID::io_err;
+		}
+		if(i == 0) {
+			all = std::move(one);
+			continue;
+		}
+
+		if(one.unit != all.unit) {
+			std::cerr << "error: " << paths[i] << " counts in other units than " << paths[0]
+				<< " (--decimal and --precision differ)\n";
+			return returnID::conflict_err;
+		}
+		if(one.hist.has_value() != all.hist.has_value() || (one.hist && !all.hist->merge(*one.hist))) {
+			std::cerr << "error: " << paths[i] << " has other --stat-hist bins than " << paths[0] << '\n';
+			return returnID::conflict_err;
+		}
+		for(const auto & s : one.shards)
+			for(const auto & t : all.shards)
+				if(s.generator == t.generator && s.seed == t.seed)
+					std::cerr << "warning: " << paths[i] << " repeats the " << s.generator
+						<< " engine and seed " << s.seed << " of an earlier summary\n";
+		all.shards.insert(all.shards.end(), one.shards.begin(), one.shards.end());
+		all.stats.merge(one.stats);
+		all.sketch.merge(one.sketch);
+	}
+	return returnID::success;
+}
+
+// Parses --analyze input into values in the units of the stats: text
+// numbers separated by whitespace, commas or the --delim characters, or
+// raw records of the given format.
+class input_parser {
+public:
+	input_parser(const program_args & args, const output_format format)
+		: format(format), width(format_sizes[static_cast<int>(format)]),
+		unit(args.unit), decimal(args.decimal) {
+		for(const unsigned char c : " \t\n\r\v\f," + args.delim) separator[c] = true;
+	}
+
+	// Parses [first, last) into values until limit values are in; returns
+	// where it stopped. A number cut off by last waits for more input unless
+	// final. Throws on input that is not a number.
+	const char * parse(const char * first, const char * last, const bool final,
+			std::vector<long double> & values, const std::size_t limit) const {
+		if(width != 0) {
+			for(; last - first >= width && values.size() < limit; first += width)
+				values.push_back(record(first));
+			if(final && first != last && values.size() < limit)
+				throw std::runtime_error("input ends inside a raw number");
+			return first;
+		}
+		while(first != last && values.size() < limit) {
+			if(separator[static_cast<unsigned char>(*first)]) {
+				++first;
+				continue;
 			}
+			const char * end = first;
+			while(end != last && !separator[static_cast<unsigned char>(*end)]) ++end;
+			if(end == last && !final) break;
+			long double v;
+			const auto [ptr, ec] = std::from_chars(first, end, v);
+			if(ec != std::errc() || ptr != end)
+				throw std::runtime_error("cannot parse \"" + std::string(first, std::min<std::ptrdiff_t>(end - first, 40)) + '"');
+			values.push_back(decimal ? std::round(v * unit) : v);
+			first = end;
+		}
+		return first;
+	}
+
+	// The first byte at or after at where a stretch of input can start.
+	const char * boundary(const char * at, const char * first, const char * last) const {
+		if(width != 0) return first + (at - first) / width * width;
+		while(at != last && at != first && !separator[static_cast<unsigned char>(at[-1])]) ++at;
+		return at;
+	}
+
+private:
+	output_format format;
+	std::ptrdiff_t width;
+	long double unit;
+	bool decimal;
+	std::array<bool, 256> separator{};
+
+	template<typename T>
+	static T load(const char * p, const std::size_t size = sizeof(T)) {
+		T v{};
+		std::memcpy(&v, p, size);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::reverse(reinterpret_cast<char *>(&v), reinterpret_cast<char *>(&v) + size);
+#endif
+		return v;
+	}
+
+	// Raw output holds values divided by the unit, except raw-i64.
+	long double record(const char * p) const {
+		switch(format) {
+			case output_format::raw_f32: return load<float>(p) * unit;
+			case output_format::raw_f64: return load<double>(p) * unit;
+			case output_format::raw_f80: return load<long double>(p, 10) * unit;
+			default: return load<long long>(p);
 		}
 	}
+};
+
+// The format of --analyze input: the one in a DRAW header, which is then
+// skipped, or a raw --format, or text.
+output_format input_format(const program_args & args, const char * data, const std::size_t size,
+		std::size_t & skip) {
+	skip = 0;
+	if(size < 24 || std::memcmp(data, "DRAW", 4) != 0)
+		return binary(args.format) ? args.format : output_format::text;
+	const auto type = static_cast<unsigned char>(data[5]);
+	if(type >= std::size(format_sizes) || !binary(static_cast<output_format>(type))
+			|| static_cast<unsigned char>(data[6]) != format_sizes[type])
+		throw std::runtime_error("DRAW header names no raw format");
+	skip = 24;
+	return static_cast<output_format>(type);
+}
+
+// --analyze: reads numbers from fd and hands them to sink(t, batch) a batch
+// at a time from thread t. Regular files are mapped and cut at separators
+// or whole records into one stretch per thread; anything else streams
+// through thread 0.
+template<typename F>
+returnID read_input(const program_args & args, const int fd, const unsigned threads, F sink) {
+	const std::size_t batch_size = args.batch_size;
+
+	try {
+		struct stat info;
+		void * map = MAP_FAILED;
+		if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+			map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map != MAP_FAILED) {
+			const std::size_t size = info.st_size;
+			madvise(map, size, MADV_SEQUENTIAL);
+			std::size_t skip;
+			const char * const data = static_cast<const char *>(map);
+			const input_parser parser(args, input_format(args, data, size, skip));
+			const char * const first = data + skip, * const last = data + size;
+
+			const unsigned workers = std::max<std::size_t>(1, std::min<std::size_t>(threads, size >> 20));
+			std::vector<const char *> cuts{first};
+			for(unsigned t = 1; t < workers; ++t)
+				cuts.push_back(std::max(cuts.back(), parser.boundary(first + (last - first) * t / workers, first, last)));
+			cuts.push_back(last);
+
+			std::vector<std::exception_ptr> errors(workers);
+			std::vector<std::thread> pool;
+			for(unsigned t = 0; t < workers; ++t) {
+				pool.emplace_back([&, t]() {
+					try {
+						std::vector<long double> batch;
+						for(const char * p = cuts[t]; p != cuts[t + 1];) {
+							batch.clear();
+							p = parser.parse(p, cuts[t + 1], true, batch, batch_size);
+							if(!batch.empty()) sink(t, batch);
+						}
+					} catch(...) {
+						errors[t] = std::current_exception();
+					}
+				});
+			}
+			for(auto & thread : pool) thread.join();
+			munmap(map, size);
+			for(const auto & error : errors) if(error) std::rethrow_exception(error);
+			return returnID::success;
+		}
 
+		// Pipes and ttys: a buffer at a time, keeping a cut-off number for the next.
+		std::vector<char> buffer(1 << 20);
+		std::size_t have = 0;
+		std::optional<input_parser> parser;
+		std::vector<long double> batch;
+		for(bool eof = false; !eof && !interrupted;) {
+			const ssize_t got = ::read(fd, buffer.data() + have, buffer.size() - have);
+			if(got < 0 && errno == EINTR) continue;
+			if(got < 0) throw std::system_error(errno, std::generic_category(), "read");
+			eof = got == 0;
+			have += got;
+			if(!parser) {
+				if(have < 24 && !eof) continue;
+				std::size_t skip;
+				parser.emplace(args, input_format(args, buffer.data(), have, skip));
+				std::memmove(buffer.data(), buffer.data() + skip, have -= skip);
+			}
+			const char * p = buffer.data(), * const end = p + have;
+			for(const char * q = nullptr; q != p;) {
+				if(q) p = q;
+				batch.clear();
+				q = parser->parse(p, end, eof, batch, batch_size);
+				if(!batch.empty()) sink(0u, batch);
+			}
+			std::memmove(buffer.data(), p, have = end - p);
+			if(have == buffer.size()) throw std::runtime_error("a number is longer than the read buffer");
+		}
+	} catch(const std::runtime_error & e) {
+		std::cerr << "error: --analyze " << args.input << ": " << e.what() << '\n';
+		return returnID::io_err;
+	}
 	return returnID::success;
 }
 
-template<typename GEN = std::mt19937, typename DIST = std::uniform_real_distribution<long double> >
-std::function<long double()> r_gen(const program_args & args) {
-	GEN generator{std::random_device{}()};
-	DIST dis{args.lbound, args.ubound};
-	return [dis, generator]() mutable -> auto { return dis(generator); };
+// --analyze FILE, or stdin for "-".
+template<typename F>
+returnID read_input(const program_args & args, const unsigned threads, F sink) {
+	if(args.input == "-") return read_input(args, STDIN_FILENO, threads, sink);
+	const int fd = ::open(args.input.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		std::cerr << "error: cannot open --analyze file " << args.input << ": " << std::strerror(errno) << '\n';
+		return returnID::io_err;
+	}
+	const auto result = read_input(args, fd, threads, sink);
+	::close(fd);
+	return result;
 }
 
-long double random(const program_args & args) {
-	if(args.generator == "minstd_rand0") return r_gen<std::minstd_rand0>(args)();
-	else if(args.generator == "minstd_rand") return r_gen<std::minstd_rand>(args)();
-	else if(args.generator == "mt19937_64") return r_gen<std::mt19937_64>(args)();
-	else if(args.generator == "ranlux24_base") return r_gen<std::ranlux24_base>(args)();
-	else if(args.generator == "ranlux48_base") return r_gen<std::ranlux48_base>(args)();
-	else if(args.generator == "ranlux24") return r_gen<std::ranlux24>(args)();
-	else if(args.generator == "ranlux48") return r_gen<std::ranlux48>(args)();
-	else if(args.generator == "knuth_b") return r_gen<std::knuth_b>(args)();
-	else if(args.generator == "default_random_engine") return r_gen<std::default_random_engine>(args)();
-	else if(args.generator == "badrandom")
-		return args.lbound + (std::rand() / (RAND_MAX / (args.ubound - args.lbound)));
-	else return r_gen<std::mt19937>(args)();
+std::string json_string(const std::string_view s) {
+	std::string json = "\"";
+	for(const char c : s) {
+		if(c == '"' || c == '\\') json += '\\';
+		if(static_cast<unsigned char>(c) < 0x20) {
+			char escape[8];
+			std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+			json += escape;
+		} else {
+			json += c;
+		}
+	}
+	return json + '"';
 }
 
-bool filter(const long double rand, const int precision,
-		const std::vector<std::string> & fx,
-		bool(*predicate)(const std::string&, const std::string&)) {
+// v as fmt would print it, or null where JSON has no number for it.
+std::string json_number(const long double v, const std::ios & fmt) {
+	if(!std::isfinite(v)) return "null";
 	std::ostringstream oss;
-	oss << std::fixed << std::setprecision(precision) << rand;
-	const auto str_rand = oss.str();
-	return std::none_of(fx.begin(), fx.end(), [&](auto const & s) { return predicate(str_rand, s); });
+	oss.copyfmt(fmt);
+	oss << v;
+	return oss.str();
+}
+
+// One --flags entry: its text label and JSON key (either may be null to
+// leave it out of that form) and its value in both.
+struct flag_row {
+	const char * section, * name, * key;
+	std::string text, json;
+};
+
+// Every option and the analysis for --flags, numbers formatted like fmt.
+std::vector<flag_row> flag_rows(const program_args & args, const std::ios & fmt) {
+	std::vector<flag_row> rows;
+	const char * section = "General options";
+	const auto number = [&](const auto v) {
+		std::ostringstream oss;
+		oss.copyfmt(fmt);
+		oss << v;
+		return oss.str();
+	};
+	const auto flag = [&](const char * name, const bool v) {
+		rows.push_back({section, name, name, v ? "1" : "0", v ? "true" : "false"});
+	};
+	const auto value = [&](const char * name, const auto v) {
+		rows.push_back({section, name, name, number(v),
+			std::is_integral_v<decltype(v)> ? number(v) : json_number(v, fmt)});
+	};
+	const auto text = [&](const char * name, const std::string & v) {
+		rows.push_back({section, name, name, v, json_string(v)});
+	};
+	const auto list = [&](const char * name, const auto & v) {
+		std::string t, j;
+		for(const auto & i : v) {
+			if(!j.empty()) j += ", ";
+			if constexpr(std::is_arithmetic_v<std::decay_t<decltype(i)> >) {
+				t += number(i);
+				j += json_number(i, fmt);
+			} else {
+				t += i;
+				j += json_string(i);
+			}
+			t += ' ';
+		}
+		rows.push_back({section, name, name, t, '[' + j + ']'});
+	};
+
+	flag("help", false);
+	value("precision", args.precision);
+	flag("quiet", args.quiet);
+	text("format", args.format_name);
+	flag("header", args.header);
+	text("output", args.output);
+	flag("direct", args.direct);
+	flag("mmap", args.mmap);
+	value("threads", args.threads);
+	flag("splice", args.splice);
+	flag("list", args.list);
+	flag("numbers-force", args.numbers_force);
+	flag("flags", true);
+	flag("profile", args.profile);
+	value("batch-size", args.batch_size);
+	text("trace", args.trace);
+	text("delim", args.delim);
+	section = "Internal RNG options";
+	if(args.endless) text("number", "inf");
+	else value("number", args.number);
+	value("lbound", args.lbound);
+	value("ubound", args.ubound);
+	text("generator", args.generator);
+	value("seed", args.seed);
+	flag("decimal", args.decimal);
+	section = "Rounding options";
+	flag("ceil", args.ceil);
+	flag("floor", args.floor);
+	flag("round", args.round);
+	flag("trunc", args.trunc);
+	section = "Matcher options";
+	list("exclude", args.excluded);
+	list("include", args.included);
+	flag("norepeat", args.norepeat);
+	list("prefix", args.prefix);
+	list("suffix", args.suffix);
+	list("contains", args.contains);
+	list("match", args.match);
+	section = "Statistics options";
+	flag("stat-all", args.stat_all);
+	flag("stat-min", args.stat_min);
+	flag("stat-max", args.stat_max);
+	flag("stat-median", args.stat_median);
+	flag("stat-avg", args.stat_avg);
+	flag("stat-var", args.stat_var);
+	flag("stat-std", args.stat_std);
+	flag("stat-coef", args.stat_coef);
+	flag("stat-skew", args.stat_skew);
+	flag("stat-kurt", args.stat_kurt);
+	flag("stat-mode", args.stat_mode);
+	value("stat-topk", args.stat_topk);
+	list("stat-quantile", args.quantiles);
+	value("sketch-error", args.sketch_error);
+	value("stat-hist", args.stat_hist);
+	text("emit-summary", args.emit_summary);
+	list("merge", args.merge);
+	text("analyze", args.input);
+	value("stat-window", args.stat_window);
+	value("stat-every", args.stat_every);
+
+	section = "Analysis";
+	std::ostringstream six;
+	six << std::defaultfloat << std::setprecision(6);
+	const auto acceptance = json_number(args.acceptance, six);
+	rows.push_back({section, "acceptance", "acceptance",
+		acceptance + (args.acceptance_exact ? "" : " (estimated)"), acceptance});
+	rows.push_back({section, nullptr, "acceptance-exact", "", args.acceptance_exact ? "true" : "false"});
+	six.str("");
+	six << args.expected_draws;
+	rows.push_back({section, "expected draws per number", "expected-draws",
+		six.str(), json_number(args.expected_draws, six)});
+	return rows;
+}
+
+void print_flags(std::ostream & os, const std::vector<flag_row> & rows) {
+	os << "\nFlags:\n";
+	const char * section = nullptr;
+	for(const auto & row : rows) {
+		if(!row.name) continue;
+		if(row.section != section) {
+			os << (section ? "\n" : "") << " - " << row.section << ':';
+			section = row.section;
+		}
+		os << "\n\t" << row.name << ": " << row.text;
+	}
+	os << '\n';
+}
+
+std::string json_flags(const std::vector<flag_row> & rows) {
+	std::string json = "{";
+	for(const auto & row : rows) {
+		if(!row.key) continue;
+		if(json.size() > 1) json += ", ";
+		json += '"';
+		json += row.key;
+		json += "\": " + row.json;
+	}
+	return json + '}';
 }
 
 int main(int argc, char* argv[]) {
@@ -224,138 +3731,472 @@ int main(int argc, char* argv[]) {
 			default: return result;
 		}
 
+		if(args.bench_format > 0) {
+			bench_format<float>("float", args.bench_format, std::numeric_limits<float>::max_digits10);
+			bench_format<double>("double", args.bench_format, std::numeric_limits<double>::max_digits10);
+			bench_format<long double>("long double", args.bench_format, args.precision);
+			return returnID::success;
+		}
+
+		// A reader going away shows up as EPIPE, which ends the run as an
+		// interrupt does.
+		std::signal(SIGPIPE, SIG_IGN);
+		struct sigaction stop{};
+		stop.sa_handler = interrupt;
+		stop.sa_flags = SA_RESETHAND;
+		sigaction(SIGINT, &stop, nullptr);
+		sigaction(SIGTERM, &stop, nullptr);
+
+		if(!args.trace.empty() && !trace.open(args.trace)) {
+			std::cerr << "error: cannot open --trace file " << args.trace << '\n';
+			return returnID::io_err;
+		}
+
+		// Values are only kept for --norepeat and exact quantiles; every other
+		// stat streams through summary, and sketched quantiles through sketch.
+		// --emit-summary streams and sketches everything; --merge reads it all.
 		std::vector<long double> generated;
+		running_stats summary;
+		const bool merging = !args.merge.empty();
+		const bool analyzing = !args.input.empty();
+		const bool emitting = !args.emit_summary.empty();
+		const bool ranked = args.stat_all || args.stat_median || !args.quantiles.empty();
+		const bool sketched = ranked && (args.sketch_error > 0 || merging);
+		const bool sketching = sketched || emitting;
+		const bool keep = args.norepeat || (ranked && !sketched);
+		quantile_sketch sketch(!sketching ? 8
+			: args.sketch_error > 0 ? std::max(8.0L, std::ceil(2 / args.sketch_error)) : 2000);
+		const bool streamed = args.stat_all || args.stat_min || args.stat_max || args.stat_avg
+			|| args.stat_var || args.stat_std || args.stat_coef || args.stat_skew || args.stat_kurt
+			|| emitting;
+		// Skewness and kurtosis need the third and fourth powers summed too.
+		const bool higher = args.stat_skew || args.stat_kurt || emitting;
+		const auto moments = [higher](const auto first, const auto last, const auto value) {
+			return higher ? running_stats::of<true>(first, last, value) : running_stats::of(first, last, value);
+		};
 
-		std::cout.precision(args.precision);
+		// Numbers go through output_writer; iostreams only carry the stats
+		// and flags once the numbers are out, on stderr for csv and binary
+		// output. ndjson and json put them in a trailer instead.
+		const bool text = args.format == output_format::text;
+		const bool raw = binary(args.format);
+		const bool structured = !text && !raw;
+		const bool trailer = args.format == output_format::ndjson || args.format == output_format::json;
+		std::ostream & report = text ? std::cout : std::cerr;
+		std::ios::sync_with_stdio(false);
+		report.precision(args.precision);
+		int output = STDOUT_FILENO;
+		if(!args.output.empty()) {
+			output = ::open(args.output.c_str(), (args.mmap ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC | O_CLOEXEC
+				| (args.direct ? O_DIRECT : 0), 0666);
+			if(output < 0) {
+				std::cerr << "error: cannot open --output file " << args.output
+					<< ": " << std::strerror(errno) << '\n';
+				return returnID::io_err;
+			}
+			// Preallocated files grow in large extents, not write by write.
+			if(output_size(args) > 0) fallocate(output, 0, 0, output_size(args));
+		}
+		output_writer out(output);
+		const bool mapped = args.mmap && !args.quiet;
+		if(args.splice) out.splice();
+		if(!args.output.empty() && !mapped) out.queue(4);
 
-		if(args.generator == "badrandom") std::srand(std::time(nullptr));
+		profile.enabled = args.profile;
+		profile.start();
 
-		long long list_cnt = 0;
+		if(args.bytes != 0) {
+			with_generator(args, [&](auto & generator) { write_bytes(out, generator, args.bytes); });
+			out.finish();
+			profile.report(std::cerr);
+			return returnID::success;
+		}
 
-		for(long long i = 1; i <= args.number;) {
-			if(!args.numbers_force) ++i;
-			if(args.list) ++list_cnt;
+		if(raw && args.header && !args.quiet) write_header(out, args);
+		if(structured) begin_structured(out, args);
 
-			long double rand = random(args);
+		// Integer-valued output over a small range prints from a table.
+		number_table table;
+		const bool rounding = args.ceil || args.floor || args.round || args.trunc;
+		const bool tabled = !args.quiet && !raw && (args.decimal || rounding)
+			&& std::fabs(args.lbound) < 9e18L && std::fabs(args.ubound) < 9e18L && table.build(
+			args.decimal ? args.decimal_min : static_cast<long long>(rounded(args, args.lbound)),
+			args.decimal ? args.decimal_max : static_cast<long long>(rounded(args, args.ubound)),
+			args.precision, text ? args.delim : "");
 
-			if(args.ceil) rand = std::ceil(rand);
-			else if(args.floor) rand = std::floor(rand);
-			else if(args.round) rand = std::round(rand);
-			else if(args.trunc) rand = std::trunc(rand);
+		// --stat-hist counts integer-valued numbers one by one when the range
+		// allows, in units like every stat. --analyze input is neither
+		// rounded nor kept in range, so it is binned over [lbound, ubound]
+		// and its modes hashed.
+		auto [hist_lo, hist_hi] = count_range(args);
+		if(analyzing) hist_lo = args.lbound * args.unit, hist_hi = args.ubound * args.unit;
+		const bool countable = (args.decimal || rounding) && !analyzing
+			&& hist_hi - hist_lo <= histogram::max_exact;
+		histogram hist(std::max(1ll, args.stat_hist), hist_lo, hist_hi, args.stat_hist && countable);
+		value_counts modes(hist_lo, hist_hi, args.stat_mode && countable);
+		top_values top(args.stat_topk);
 
-			if(!args.excluded.empty() && std::find(args.excluded.begin(), args.excluded.end(), rand) != args.excluded.end())
-				continue;
-			else if(!args.included.empty() && std::find(args.included.begin(), args.included.end(), rand) == args.included.end())
-				continue;
-			else if(args.norepeat && std::find(generated.begin(), generated.end(), rand) != generated.end())
-				continue;
-			else if(!args.prefix.empty() && filter(rand, args.precision, args.prefix, boost::starts_with))
-				continue;
-			else if(!args.suffix.empty() && filter(rand, args.precision, args.suffix, boost::ends_with))
-				continue;
-			else if(!args.contains.empty() && filter(rand, args.precision, args.contains, boost::contains))
-				continue;
+		// --stat-window records go to stderr as they fall due, one write
+		// each, so that they never wait on the numbers or hold them up.
+		rolling_stats window(args.stat_window);
+		const long long every = args.stat_every ? args.stat_every : std::max(1ll, args.stat_window);
+		const auto window_record = [&]() {
+			std::ostringstream fmt, line;
+			fmt << std::fixed << std::setprecision(args.precision);
+			line.copyfmt(fmt);
+			const long double values[] = {window.mean() / args.unit,
+				window.variance() / (args.unit * args.unit), window.min() / args.unit, window.max() / args.unit};
+			const char * const names[] = {"avg", "variance", "min", "max"};
+			if(trailer) {
+				line << "{\"window\": {\"at\": " << window.total() << ", \"count\": " << window.count();
+				for(int i = 0; i < 4; ++i) line << ", \"" << names[i] << "\": " << json_number(values[i], fmt);
+				line << "}}\n";
+			} else {
+				line << "window at " << window.total() << ": count " << window.count();
+				for(int i = 0; i < 4; ++i) line << ", " << names[i] << ' ' << values[i];
+				line << '\n';
+			}
+			std::cerr << line.str();
+		};
+
+		// Numbers move through the stages a batch at a time. Without
+		// --numbers-force --number counts draws, with it accepted numbers.
+		long long draws = 0, accepted = 0, emitted = 0;
+		std::vector<long double> batch;
+		std::vector<std::pair<long double, long long> > kept;
+
+		// --mmap writes every number in place, leaving the loop nothing to do.
+		if(mapped) {
+			out.finish();
+			write_mapped(output, args);
+			draws = accepted = args.number;
+			profile.draws = profile.accepted = args.number;
+		}
 
-			generated.push_back(rand);
+		// --merge takes its stats from the summaries and draws nothing.
+		run_summary merged;
+		if(merging) {
+			if(const auto result = merge_summaries(args.merge, merged); result != returnID::success)
+				return result;
+			if(args.stat_hist && !merged.hist) {
+				std::cerr << "error: --stat-hist needs summaries written with --stat-hist\n";
+				return returnID::conflict_err;
+			}
+			summary = merged.stats;
+			sketch = merged.sketch;
+			if(merged.hist) hist = *merged.hist;
+			args.unit = merged.unit;
+			for(const auto & s : merged.shards) draws += s.draws, accepted += s.accepted;
+		}
+
+		// --analyze gathers the stats of each thread's stretch of input apart
+		// and merges them in input order. A part's counters are copied when
+		// its thread first reports, as read_input may use fewer threads than
+		// asked for.
+		if(analyzing) {
+			struct part {
+				running_stats summary;
+				quantile_sketch sketch;
+				histogram hist;
+				value_counts modes;
+				top_values top;
+				std::vector<long double> values;
+				long long count;
+			};
+			const unsigned workers = args.threads ? args.threads : std::thread::hardware_concurrency();
+			std::vector<std::optional<part> > parts(std::max(1u, workers));
+			const profiler::scope timed{profile, profiler::parse};
+			const tracer::span span{trace, "analyze"};
+			const auto result = read_input(args, parts.size(), [&](const unsigned t, const auto & batch) {
+				if(!parts[t]) parts[t].emplace(part{{}, sketch, hist, modes, top, {}, 0});
+				auto & p = *parts[t];
+				const auto same = [](const long double v) { return v; };
+				if(streamed) p.summary.merge(moments(batch.begin(), batch.end(), same));
+				if(args.stat_mode) p.modes.add(batch.begin(), batch.end(), same);
+				if(args.stat_topk) p.top.add(batch.begin(), batch.end(), same);
+				if(sketching) for(const auto v : batch) p.sketch.add(v);
+				if(args.stat_hist) p.hist.add(batch.begin(), batch.end(), same);
+				if(keep) p.values.insert(p.values.end(), batch.begin(), batch.end());
+				p.count += batch.size();
+			});
+			if(result != returnID::success) return result;
+			for(auto & part : parts) {
+				if(!part) continue;
+				auto & p = *part;
+				summary.merge(p.summary);
+				sketch.merge(p.sketch);
+				hist.merge(p.hist);
+				modes.merge(p.modes);
+				top.merge(p.top);
+				generated.insert(generated.end(), p.values.begin(), p.values.end());
+				draws = accepted += p.count;
+			}
+			profile.draws = profile.accepted = accepted;
+		}
+
+		if(!merging && !analyzing) with_generator(args, [&](auto & generator) {
+			while(!interrupted && !out.broken()
+					&& (args.numbers_force ? accepted < args.number : draws < args.number)) {
+				const long long first = draws;
+				const auto count = args.numbers_force ? args.batch_size
+					: std::min(args.batch_size, args.number - draws);
+
+				{
+					const profiler::scope timed{profile, profiler::generate};
+					const tracer::span span{trace, "generate", count};
+					batch.resize(count);
+					for(auto & rand : batch) rand = random(args, generator);
+					draws += count;
+				}
+
+				{
+					const tracer::span span{trace, "filter", count};
+					{
+						const profiler::scope timed{profile, profiler::round};
+						for(auto & rand : batch) rand = rounded(args, rand);
+					}
+
+					kept.clear();
+					for(long long j = 0; j < count; ++j) {
+						const auto rand = batch[j];
+						if(rejected(args, rand))
+							continue;
+						if(args.norepeat) {
+							const profiler::scope timed{profile, profiler::dedup};
+							if(std::find(generated.begin(), generated.end(), rand) != generated.end())
+								continue;
+						}
+
+						if(keep) generated.push_back(rand);
+						kept.emplace_back(rand, first + j + 1);
+
+						// Draws past the last number needed are discarded.
+						if(++accepted == args.number && args.numbers_force) {
+							draws = first + j + 1;
+							break;
+						}
+					}
+				}
+
+				if(streamed) {
+					const profiler::scope timed{profile, profiler::stat_stream};
+					summary.merge(moments(kept.begin(), kept.end(), [](const auto & k) { return k.first; }));
+				}
+				if(args.stat_mode || args.stat_topk) {
+					const profiler::scope timed{profile, profiler::stat_stream};
+					const auto first = [](const auto & k) { return k.first; };
+					if(args.stat_mode) modes.add(kept.begin(), kept.end(), first);
+					if(args.stat_topk) top.add(kept.begin(), kept.end(), first);
+				}
+				if(sketching) {
+					const profiler::scope timed{profile, profiler::stat_sketch};
+					for(const auto & k : kept) sketch.add(k.first);
+				}
+				if(args.stat_hist) {
+					const profiler::scope timed{profile, profiler::stat_hist};
+					hist.add(kept.begin(), kept.end(), [](const auto & k) { return k.first; });
+				}
+				if(args.stat_window) {
+					const profiler::scope timed{profile, profiler::stat_window};
+					for(const auto & k : kept) {
+						window.add(k.first);
+						if(window.total() % every == 0) window_record();
+					}
+				}
+
+				profile.draws = draws;
+				profile.accepted = accepted;
+				if(args.quiet) continue;
+
+				{
+					const profiler::scope timed{profile, profiler::format};
+					const tracer::span span(trace, "format", kept.size());
+					if(raw) write_raw(out, args, kept);
+					else if(text) write_text(out, args, kept, emitted, tabled ? &table : nullptr);
+					else write_structured(out, args, kept, emitted, tabled ? &table : nullptr);
+					emitted += kept.size();
+				}
+
+				// Small batches accumulate until the writer has enough; an
+				// endless feed goes out a batch at a time.
+				if(out.due() || args.endless) {
+					const profiler::scope timed{profile, profiler::write};
+					const tracer::span span(trace, "write", out.pending());
+					out.flush();
+				}
+			}
+		});
 
-			if(!args.quiet) {
-				if(args.list && args.numbers_force) std::cout << i << ". ";
-				if(args.list) std::cout << list_cnt << ". ";
-				std::cout << std::fixed << rand << args.delim;
-				if(args.numbers_force) ++i;
+		if(args.delim != "\n" && !args.quiet && text) out.put('\n');
+
+		{
+			const profiler::scope timed{profile, profiler::write};
+			const tracer::span span(trace, "write", out.pending());
+			out.finish();
+		}
+		// An interrupted run leaves a preallocated --output longer than what
+		// was written, and a header counting numbers that never came.
+		if(interrupted && !args.output.empty() && !mapped) {
+			const bool patch = raw && args.header && !args.quiet && out.position() >= 24;
+			char count[8];
+			if(patch) little_endian(count, static_cast<unsigned long long>(out.position() - 24)
+				/ format_sizes[static_cast<int>(args.format)]);
+			if(ftruncate(output, out.position()) != 0 || (patch && pwrite(output, count, 8, 8) != 8)) {
+				std::cerr << "error: cannot fix up --output file " << args.output
+					<< ": " << std::strerror(errno) << '\n';
+				return returnID::io_err;
+			}
+		}
+		// With the reader gone, the report that would follow the numbers
+		// goes to stderr.
+		const auto cout_buffer = std::cout.rdbuf();
+		if(out.broken()) std::cout.rdbuf(std::cerr.rdbuf());
+
+		if(emitting) {
+			if(!merging) {
+				if(analyzing) merged.shards.push_back({"input " + args.input, 0, draws, accepted});
+				else merged.shards.push_back({args.generator, args.seed, draws, accepted});
+				merged.unit = args.unit;
+				merged.stats = summary;
+				merged.sketch = sketch;
+				if(args.stat_hist) merged.hist = hist;
+			}
+			std::ofstream file(args.emit_summary, std::ios::binary);
+			file << merged.save();
+			if(!file) {
+				std::cerr << "error: cannot write --emit-summary file " << args.emit_summary << '\n';
+				return returnID::io_err;
 			}
 		}
 
-		if(args.delim != "\n" && !args.quiet) std::cout << '\n';
+		const tracer::span stats_span(trace, "stats", accepted);
 
 		if((args.stat_all || args.stat_min || args.stat_max || args.stat_median || args.stat_avg
-			|| args.stat_var || args.stat_std || args.stat_coef) && !args.quiet)
-			std::cout << '\n';
+			|| args.stat_var || args.stat_std || args.stat_coef || !args.quantiles.empty()
+			|| args.stat_skew || args.stat_kurt || args.stat_mode || args.stat_topk || args.stat_hist)
+			&& !args.quiet && text && !out.broken())
+			report << '\n';
+
+		// Each stat prints as a line of the report or joins the trailer.
+		std::string stats;
+		const auto stat = [&](const char * name, const char * key, const long double value) {
+			if(!trailer) {
+				report << std::fixed << name << ": " << value << '\n';
+				return;
+			}
+			std::ostringstream fmt;
+			fmt << std::fixed << std::setprecision(args.precision);
+			stats += stats.empty() ? "\"" : ", \"";
+			stats += key;
+			stats += "\": " + json_number(value, fmt);
+		};
 
-		if(args.stat_all || args.stat_min || args.stat_max) {
-			auto minmax = std::minmax_element(generated.begin(), generated.end());
-			if(args.stat_all || args.stat_min)
-				std::cout << std::fixed << "min: " << *minmax.first << '\n';
-			if(args.stat_all || args.stat_max)
-				std::cout << std::fixed << "max: " << *minmax.second << '\n';
+		// Stats run on the generated units and are scaled back for printing.
+		if(args.stat_all || args.stat_min) stat("min", "min", summary.min() / args.unit);
+		if(args.stat_all || args.stat_max) stat("max", "max", summary.max() / args.unit);
+
+		// The median and the quantiles come from one select over the draws.
+		const unsigned workers = args.threads ? args.threads : std::thread::hardware_concurrency();
+		std::vector<long double> exact;
+		if(ranked && !sketched) {
+			std::vector<long double> qs = args.quantiles;
+			if(args.stat_all || args.stat_median) qs.insert(qs.begin(), 0.5);
+			const profiler::scope timed{profile, args.quantiles.empty()
+				? profiler::stat_median : profiler::stat_quantile};
+			const tracer::span span{trace, "stat_select"};
+			exact = exact_quantiles(generated, qs, workers);
 		}
+		std::size_t next = 0;
 
 		if(args.stat_all || args.stat_median) {
-			auto midpoint = generated.begin() + generated.size() / 2;
-			std::nth_element(generated.begin(), midpoint, generated.end());
-			auto median = *midpoint;
-			if(generated.size() % 2 == 0)
-				median = (median + *std::max_element(generated.begin(), midpoint)) / 2;
-			std::cout << std::fixed << "median: " << median << '\n';
+			const profiler::scope timed{profile, profiler::stat_median};
+			const tracer::span span{trace, "stat_median"};
+			const auto median = sketched ? sketch.quantile(0.5) : exact[next++];
+			stat("median", "median", median / args.unit);
 		}
 
-		if(args.stat_all || args.stat_avg) {
-			long double avg = std::accumulate(generated.begin(), generated.end(), 0.0) / generated.size();
-			std::cout << std::fixed << "avg: " << avg << '\n';
+		if(!args.quantiles.empty()) {
+			const profiler::scope timed{profile, profiler::stat_quantile};
+			const tracer::span span{trace, "stat_quantile"};
+			for(const auto q : args.quantiles) {
+				std::ostringstream label;
+				label << std::defaultfloat << q;
+				const auto value = sketched ? sketch.quantile(q) : exact[next++];
+				stat(("quantile " + label.str()).c_str(), ("q" + label.str()).c_str(), value / args.unit);
+			}
 		}
 
-		if(args.stat_all || args.stat_var) {
-			long double avg = std::accumulate(generated.begin(), generated.end(), 0.0) / generated.size();
-			long double var = 0.0;
-			for(const auto & i : generated) var += std::pow(i - avg, 2);
-			std::cout << std::fixed << "variance: " << var / generated.size() << '\n';
+		const auto avg = summary.mean(), std = std::sqrt(summary.variance());
+		if(args.stat_all || args.stat_avg) stat("avg", "avg", avg / args.unit);
+		if(args.stat_all || args.stat_var)
+			stat("variance", "variance", summary.variance() / (args.unit * args.unit));
+		if(args.stat_all || args.stat_std) stat("standard deviation", "std", std / args.unit);
+		if(args.stat_all || args.stat_coef) stat("coefficient of variation", "coef", std / avg);
+		if(args.stat_skew) stat("skewness", "skew", summary.skewness());
+		if(args.stat_kurt) stat("excess kurtosis", "kurt", summary.kurtosis());
+		if(args.stat_mode) stat("mode", "mode", modes.mode() / args.unit);
+		if(args.stat_topk) {
+			if(trailer) {
+				std::ostringstream fmt;
+				fmt << std::fixed << std::setprecision(args.precision);
+				std::string list;
+				for(const auto v : top.values()) list += (list.empty() ? "" : ", ") + json_number(v / args.unit, fmt);
+				stats += stats.empty() ? "\"" : ", \"";
+				stats += "top\": [" + list + ']';
+			} else {
+				report << std::fixed << "top " << args.stat_topk << ':';
+				for(const auto v : top.values()) report << ' ' << v / args.unit;
+				report << '\n';
+			}
 		}
 
-		if(args.stat_all || args.stat_std) {
-			long double avg = std::accumulate(generated.begin(), generated.end(), 0.0) / generated.size();
-			long double std = 0.0;
-			for(const auto & i : generated) std += std::pow(i - avg, 2);
-			std::cout << std::fixed << "standard deviation: " << std::sqrt(std / generated.size()) << '\n';
+		// Bins print one per line, or as an array of objects in the trailer.
+		std::string bins;
+		if(args.stat_hist) {
+			std::ostringstream fmt;
+			fmt << std::fixed << std::setprecision(args.precision);
+			for(const auto & b : hist.read()) {
+				const auto lower = b.lower / args.unit, upper = b.upper / args.unit;
+				if(trailer) {
+					bins += bins.empty() ? "[" : ", ";
+					bins += "{\"lower\": " + json_number(lower, fmt) + ", \"upper\": "
+						+ json_number(upper, fmt) + ", \"count\": " + std::to_string(b.count) + '}';
+				} else if(std::isinf(lower)) {
+					report << std::fixed << "hist below " << upper << ": " << b.count << '\n';
+				} else if(std::isinf(upper)) {
+					report << std::fixed << "hist above " << lower << ": " << b.count << '\n';
+				} else if(b.single) {
+					report << std::fixed << "hist " << lower << ": " << b.count << '\n';
+				} else {
+					report << std::fixed << "hist [" << lower << ", " << upper << "): " << b.count << '\n';
+				}
+			}
+			if(trailer) bins += ']';
 		}
 
-		if(args.stat_all || args.stat_coef) {
-			long double avg = std::accumulate(generated.begin(), generated.end(), 0.0) / generated.size();
-			long double std = 0.0;
-			for(const auto & i : generated) std += std::pow(i - avg, 2);
-			std::cout << std::fixed << "coefficient of variation: " << std::sqrt(std / generated.size()) / avg << '\n';
+		std::string flags;
+		if(args.flags) {
+			const auto rows = flag_rows(args, report);
+			if(trailer) flags = json_flags(rows);
+			else print_flags(report, rows);
 		}
 
-		if(args.flags) {
-			std::cout << "\nFlags:\n - General options:\n\thelp: 0"
-				<< "\n\tprecision: " << args.precision
-				<< "\n\tquiet: " << args.quiet
-				<< "\n\tlist: " << args.list
-				<< "\n\tnumbers-force: " << args.numbers_force
-				<< "\n\tflags: 1"
-				<< "\n\tdelim: " << args.delim
-				<< "\n - Internal RNG options:"
-				<< "\n\tnumber: " << args.number
-				<< "\n\tlbound: " << args.lbound
-				<< "\n\tubound: " << args.ubound
-				<< "\n\tgenerator: " << args.generator
-				<< "\n - Rounding options:"
-				<< "\n\tceil: " << args.ceil
-				<< "\n\tfloor: " << args.floor
-				<< "\n\tround: " << args.round
-				<< "\n\ttrunc: " << args.trunc
-				<< "\n - Matcher options:"
-				<< "\n\texclude: ";
-			for(const auto & i : args.excluded) std::cout << i << ' ';
-			std::cout << "\n\tinclude: ";
-			for(const auto & i : args.included) std::cout << i << ' ';
-			std::cout << "\n\tnorepeat: " << args.norepeat
-				<< "\n\tprefix: ";
-			for(const auto & i : args.prefix) std::cout << i << ' ';
-			std::cout << "\n\tsuffix: ";
-			for(const auto & i : args.suffix) std::cout << i << ' ';
-			std::cout << "\n\tcontains: ";
-			for(const auto & i : args.contains) std::cout << i << ' ';
-			std::cout << "\n - Statistics options:"
-				<< "\n\tstat-all: " << args.stat_all
-				<< "\n\tstat-min: " << args.stat_min
-				<< "\n\tstat-max: " << args.stat_max
-				<< "\n\tstat-median: " << args.stat_median
-				<< "\n\tstat-avg: " << args.stat_avg
-				<< "\n\tstat-var: " << args.stat_var
-				<< "\n\tstat-std: " << args.stat_std
-				<< "\n\tstat-coef: " << args.stat_coef << '\n';
+		if(structured) {
+			std::string members;
+			if(!stats.empty()) members += ", \"stats\": {" + stats + '}';
+			if(!bins.empty()) members += ", \"hist\": " + bins;
+			if(!flags.empty()) members += ", \"flags\": " + flags;
+			if(!out.broken()) {
+				end_structured(out, args, members);
+				out.finish();
+			} else if(!members.empty()) {
+				std::cerr << '{' << members.substr(2) << "}\n";
+			}
 		}
 
+		profile.report(std::cerr);
+		std::cout.rdbuf(cout_buffer);
+
 		return returnID::success;
 
 	} catch(std::exception & e) {